@@ -2,6 +2,7 @@
 
 #include <cor/container.hpp>
 #include <cor/orm.hpp>
+#include <m/geom.hpp>
 #include <shared/types.hpp>
 
 namespace assets {
@@ -25,10 +26,15 @@ struct mesh {
 
   container::span<vindex_t> m_indices;
 
+  // Set by compute_bounds, m_bounds is not initialized otherwise.
+  ui8 m_has_bounds;
+  bounding_volume m_bounds;
+
   void allocate(mesh_composition p_composition, uimax p_unique_indices_count,
                 uimax p_face_indices_count) {
 
     m_composition = p_composition;
+    m_has_bounds = 0;
 
     const uimax l_position_buffer_size =
         m_composition.m_position * sizeof(position_t) * p_unique_indices_count;
@@ -67,6 +73,35 @@ struct mesh {
     m_indices.free();
   };
 
+  // Must be called once the positions are filled.
+  void compute_bounds() {
+    assert_debug(m_composition.m_position);
+    container::range<position_t> l_positions = position();
+    m_has_bounds = 1;
+    m_bounds.m_min = l_positions.at(0);
+    m_bounds.m_max = l_positions.at(0);
+    for (uimax i = 1; i < l_positions.count(); ++i) {
+      for (auto j = 0; j < 3; ++j) {
+        if (l_positions.at(i).at(j) < m_bounds.m_min.at(j)) {
+          m_bounds.m_min.at(j) = l_positions.at(i).at(j);
+        }
+        if (l_positions.at(i).at(j) > m_bounds.m_max.at(j)) {
+          m_bounds.m_max.at(j) = l_positions.at(i).at(j);
+        }
+      }
+    }
+
+    m_bounds.m_center = (m_bounds.m_min + m_bounds.m_max) * 0.5;
+    m_bounds.m_radius = 0;
+    for (uimax i = 0; i < l_positions.count(); ++i) {
+      fix32 l_distance =
+          m::magnitude_ceil(l_positions.at(i) - m_bounds.m_center);
+      if (l_distance > m_bounds.m_radius) {
+        m_bounds.m_radius = l_distance;
+      }
+    }
+  };
+
   container::range<position_t> position() {
     return m_vertex_attributes.range(m_vertex_attribute_heap_indices.at(0))
         .cast_to<position_t>();
@@ -283,6 +318,8 @@ struct mesh_intermediary {
       }
     }
 
+    l_mesh.compute_bounds();
+
     l_per_face_indices.free();
     l_unique_indices.free();
     return l_mesh;
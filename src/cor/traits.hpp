@@ -37,6 +37,8 @@ template <typename T> struct is_none { static constexpr bool value = 0; };
 
 template <> struct is_none<none> { static constexpr bool value = 1; };
 
+template <typename...> using void_t = void;
+
 }; // namespace traits
 
 #define api_decltype(api_type, var_name, code)                                 \
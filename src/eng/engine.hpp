@@ -12,8 +12,11 @@ template <typename EngineImpl> struct engine_api {
   EngineImpl &thiz;
   engine_api(EngineImpl &p_thiz) : thiz(p_thiz){};
 
-  FORCE_INLINE void allocate(ui16 p_window_width, ui16 p_window_height) {
-    thiz.allocate(p_window_width, p_window_height);
+  // p_worker_count threads rasterize draw calls and stretch the frame to the
+  // window, 0 means one per hardware thread.
+  FORCE_INLINE void allocate(ui16 p_window_width, ui16 p_window_height,
+                             ui16 p_worker_count = 0) {
+    thiz.allocate(p_window_width, p_window_height, p_worker_count);
   };
   FORCE_INLINE void free() { thiz.free(); };
   template <typename UpdateCallback>
@@ -37,6 +40,9 @@ template <typename EngineImpl> struct engine_api {
   FORCE_INLINE input::system &input() { return thiz.m_input_system; };
   FORCE_INLINE window::system &window_system() { return thiz.m_window_system; };
   FORCE_INLINE time &time() { return thiz.m_time; };
+  FORCE_INLINE present_stats window_present_stats() {
+    return thiz.m_window_system.window_get_present_stats(thiz.m_window);
+  };
 };
 
 namespace details {
@@ -54,15 +60,18 @@ template <typename RenImpl, typename RastImpl> struct engine {
   time m_time;
 
   window_handle m_window;
+  // Camera drawn in the window.
+  inline static constexpr ren::camera_handle s_presented_camera = {.m_idx = 0};
 
-  void allocate(ui16 p_window_width, ui16 p_window_height) {
-    m_window_system.allocate();
+  void allocate(ui16 p_window_width, ui16 p_window_height,
+                ui16 p_worker_count = 0) {
+    m_window_system.allocate(p_worker_count);
     m_input_system.allocate();
 
     api_decltype(ren::ren_api, l_renderer, m_renderer);
     api_decltype(rast_api, l_rast, m_rasterizer);
 
-    l_rast.init();
+    l_rast.init({}, p_worker_count);
     l_renderer.allocate();
 
     m_time.allocate();
@@ -97,11 +106,22 @@ template <typename RenImpl, typename RastImpl> struct engine {
 
     p_update();
 
+    // The presented camera renders in the window image buffer when they have
+    // the same size and layout, so the window is drawn without copy. The alias
+    // follows the back image buffer, which changes every frame and when a
+    // resize reallocates it.
+    window_image_buffer &l_image_buffer =
+        m_window_system.window_get_back_image_buffer(m_window);
+    l_renderer.camera_set_render_target(
+        s_presented_camera, l_image_buffer.m_data.m_begin,
+        l_image_buffer.m_width, l_image_buffer.m_height,
+        s_window_image_format, l_rast);
+
     l_renderer.frame(l_rast);
     l_rast.frame();
 
     rast::image_view l_rendereed_frame =
-        m_renderer.frame_view(ren::camera_handle{.m_idx = 0}, l_rast);
+        m_renderer.frame_view(s_presented_camera, l_rast);
     m_window_system.draw_window(m_window, l_rendereed_frame);
   };
 };
@@ -111,9 +111,11 @@ public:
     api_decltype(ren::ren_api, l_ren, l_engine.renderer());
     api_decltype(rast_api, l_rast, l_engine.rasterizer());
     camera &l_camera = __get_camera();
-    l_ren.camera_set_render_width_height(l_camera.m_camera,
-                                         p_rendertexture_width,
-                                         p_rendertexture_height, l_rast);
+    // Cameras render in the window layout, so frames are presented without
+    // conversion.
+    l_ren.camera_set_render_width_height(
+        l_camera.m_camera, p_rendertexture_width, p_rendertexture_height,
+        eng::s_window_image_format, l_rast);
   };
 
   void set_orthographic(fix32 p_width, fix32 p_height, fix32 p_near,
@@ -291,15 +293,18 @@ template <typename Engine> struct scene {
       }
     }
 
-    if (m_allocated_cameras.count() > 0) {
-      struct camera &l_main_camera = m_cameras.at(m_allocated_cameras.at(0));
+    // Every camera renders the mesh renderers to its frame buffer.
+    for (auto l_camera_it = 0; l_camera_it < m_allocated_cameras.count();
+         ++l_camera_it) {
+      struct camera &l_camera =
+          m_cameras.at(m_allocated_cameras.at(l_camera_it));
       for (auto i = 0; i < m_allocated_mesh_renderers.count(); ++i) {
         struct mesh_renderer &l_mesh_renderer =
             m_mesh_renderers.at(m_allocated_mesh_renderers.at(i));
         transform *l_transform;
         m_transforms.at(l_mesh_renderer.m_transform.m_idx, &l_transform,
                         none());
-        l_ren.draw(l_main_camera.m_camera, l_mesh_renderer.m_program,
+        l_ren.draw(l_camera.m_camera, l_mesh_renderer.m_program,
                    l_mesh_renderer.m_material, l_transform->m_local_to_world,
                    l_mesh_renderer.m_mesh);
       }
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <atomic>
 #include <cor/orm.hpp>
 #include <cor/types.hpp>
 #include <rast/model.hpp>
 #include <shared/types.hpp>
+#include <sys/clock.hpp>
+#include <sys/thread.hpp>
 #include <sys/win.hpp>
 
 namespace eng {
@@ -16,28 +19,200 @@ struct window_native_ptr {
   void *m_ptr;
 };
 
+// Pixel layout of the window image buffers. X11 images are BGRA on little
+// endian hosts, the web canvas and the headless window are RGBA.
+#if !WIN_HEADLESS_PREPROCESS && !PLATFORM_WEBASSEMBLY_PREPROCESS
+inline static constexpr bgfx::TextureFormat::Enum s_window_image_format =
+    bgfx::TextureFormat::BGRA8;
+#else
+inline static constexpr bgfx::TextureFormat::Enum s_window_image_format =
+    bgfx::TextureFormat::RGBA8;
+#endif
+
+// Pixels are allocated by the platform image, in memory shared with the
+// display server when it supports it.
 struct window_image_buffer {
-  container::span<ui8> m_data;
+  container::range<ui8> m_data;
   ui16 m_width;
   ui16 m_height;
   void *m_native;
 
   void allocate(window_native_ptr p_window, ui16 p_width, ui16 p_height) {
-    m_data.allocate(p_width * p_height * (sizeof(ui8) * 4));
-    m_data.range().memset(255);
+    ui8 *l_buffer;
+    m_native =
+        win::allocate_image(p_window.m_ptr, p_width, p_height, &l_buffer);
+    m_data = container::range<ui8>::make(
+        l_buffer, p_width * p_height * (sizeof(ui8) * 4));
+    m_data.memset(255);
     m_width = p_width;
     m_height = p_height;
-    m_native =
-        win::allocate_image(p_window.m_ptr, m_data.data(), p_width, p_height);
+  };
+
+  void free() { win::free_image(m_native); };
+
+  rast::image_view image_view() {
+    return rast::image_view(m_width, m_height, sizeof(ui8) * 4, m_data);
+  };
+};
+
+struct present_stats {
+  // Frames drawn in the window.
+  uimax m_presented;
+  // Frames replaced by a newer one before being drawn.
+  uimax m_dropped;
+  // Time between the hand off of a frame and the end of its draw, for the last
+  // and the slowest presented frame.
+  ui64 m_latency_micros;
+  ui64 m_max_latency_micros;
+};
+
+// Window images are triple buffered and drawn by a thread of their own. The
+// engine renders in the back image and hands it off, the presenter always
+// draws the latest handed off image. Rendering of the next frame overlaps the
+// draw of the previous one.
+// Images are exchanged through m_ready without lock, the present thread only
+// sleeps on m_wake. Without threads, images are drawn when handed off.
+struct window_present {
+  inline static constexpr ui8 s_image_count = 3;
+  // Set on m_ready until the presenter takes the image.
+  inline static constexpr ui8 s_fresh = 1 << 7;
+
+  container::arr<window_image_buffer, s_image_count> m_images;
+  container::arr<clock_time, s_image_count> m_handoff_time;
+  window_native_ptr m_window;
+
+  // Engine side.
+  ui8 m_back;
+  ui8 m_last;
+  uimax m_dropped;
+
+  // Present thread side.
+  ui8 m_front;
+  std::atomic<uimax> m_presented;
+  std::atomic<ui64> m_latency_micros;
+  std::atomic<ui64> m_max_latency_micros;
+
+  std::atomic<ui8> m_ready;
+  std::atomic<ui8> m_exit;
+  thread_sys::thread *m_thread;
+  thread_sys::signal *m_wake;
+
+  void allocate(window_native_ptr p_window, ui16 p_width, ui16 p_height) {
+    m_window = p_window;
+    __allocate_images(p_width, p_height);
+    m_dropped = 0;
+    m_presented = 0;
+    m_latency_micros = 0;
+    m_max_latency_micros = 0;
+    m_wake = thread_sys::signal_create();
+    __start();
   };
 
   void free() {
-    m_data.free();
-    win::free_image(m_native);
+    __stop();
+    __free_images();
+    thread_sys::signal_destroy(m_wake);
   };
 
-  rast::image_view image_view() {
-    return rast::image_view(m_width, m_height, sizeof(ui8) * 4, m_data.range());
+  // The present thread is stopped while images are reallocated.
+  void resize(ui16 p_width, ui16 p_height) {
+    __stop();
+    __free_images();
+    __allocate_images(p_width, p_height);
+    __start();
+  };
+
+  // Image where the next frame is rendered.
+  window_image_buffer &back() { return m_images.at(m_back); };
+
+  // Image of the last frame handed off. It is not written until the next hand
+  // off.
+  window_image_buffer &last() { return m_images.at(m_last); };
+
+  void handoff() {
+    m_handoff_time.at(m_back) = clock_sys::get_current_time_micro();
+    m_last = m_back;
+    ui8 l_ready = m_ready.exchange(m_back | s_fresh);
+    if (l_ready & s_fresh) {
+      m_dropped += 1;
+    }
+    m_back = l_ready & ~s_fresh;
+    if (m_thread) {
+      thread_sys::signal_notify(m_wake);
+    } else {
+      __present();
+    }
+  };
+
+  present_stats stats() {
+    present_stats l_stats;
+    l_stats.m_presented = m_presented;
+    l_stats.m_dropped = m_dropped;
+    l_stats.m_latency_micros = m_latency_micros;
+    l_stats.m_max_latency_micros = m_max_latency_micros;
+    return l_stats;
+  };
+
+private:
+  void __allocate_images(ui16 p_width, ui16 p_height) {
+    for (uimax i = 0; i < m_images.count(); ++i) {
+      m_images.at(i).allocate(m_window, p_width, p_height);
+    }
+    m_back = 0;
+    m_last = 1;
+    m_ready = 1;
+    m_front = 2;
+  };
+
+  void __free_images() {
+    for (uimax i = 0; i < m_images.count(); ++i) {
+      m_images.at(i).free();
+    }
+  };
+
+  void __start() {
+    m_exit = 0;
+    m_thread = thread_sys::thread_create(
+        [](void *p_user, uimax, uimax) {
+          window_present *thiz = (window_present *)p_user;
+          while (1) {
+            thread_sys::signal_wait(thiz->m_wake);
+            if (thiz->m_exit) {
+              return;
+            }
+            thiz->__present();
+          }
+        },
+        this);
+  };
+
+  void __stop() {
+    if (m_thread) {
+      m_exit = 1;
+      thread_sys::signal_notify(m_wake);
+      thread_sys::thread_join(m_thread);
+      m_thread = 0;
+    }
+  };
+
+  void __present() {
+    if (!(m_ready.load() & s_fresh)) {
+      return;
+    }
+    m_front = m_ready.exchange(m_front) & ~s_fresh;
+    window_image_buffer &l_image = m_images.at(m_front);
+    win::draw(m_window.m_ptr, l_image.m_native, l_image.m_width,
+              l_image.m_height);
+
+    clock_time l_latency =
+        clock_sys::get_current_time_micro() - m_handoff_time.at(m_front);
+    ui64 l_latency_micros =
+        l_latency.m_seconds * clock_time::MAX_MICRO + l_latency.m_micros;
+    m_latency_micros = l_latency_micros;
+    if (l_latency_micros > m_max_latency_micros) {
+      m_max_latency_micros = l_latency_micros;
+    }
+    m_presented += 1;
   };
 };
 
@@ -45,7 +220,9 @@ namespace window {
 
 struct system {
 public:
-  void allocate() { __allocate(); };
+  // Drawn images are stretched to the window size by p_worker_count threads,
+  // 0 means one per hardware thread.
+  void allocate(ui16 p_worker_count = 0) { __allocate(p_worker_count); };
   void free() { __free(); };
 
   window_handle create_window(ui16 p_width, ui16 p_height) {
@@ -54,18 +231,17 @@ public:
 
   void open_window(window_handle p_window) { __open_window(p_window); };
   void close_window(window_handle p_window) { __close_window(p_window); };
+  // The image is copied in the back image buffer and handed off to the present
+  // thread.
   void draw_window(window_handle p_window, const rast::image_view &p_image) {
-    window_native_ptr *l_native_ptr;
-    window_image_buffer *l_image_buffer;
-    win::events *l_events;
-    m_window_table.at(p_window.m_idx, &l_native_ptr, &l_image_buffer,
-                      &l_events);
-    rast::image_copy_stretch((rgb_t *)p_image.m_buffer.m_begin, p_image.m_width,
-                             p_image.m_height,
-                             (rgba_t *)l_image_buffer->m_data.m_data,
-                             l_image_buffer->m_width, l_image_buffer->m_height);
-    win::draw(l_native_ptr->m_ptr, l_image_buffer->m_native,
-              l_image_buffer->m_width, l_image_buffer->m_height);
+    window_present **l_present;
+    m_window_table.at(p_window.m_idx, none(), &l_present);
+    window_image_buffer &l_image_buffer = (*l_present)->back();
+    // Frames rendered in the back image buffer are drawn in place.
+    if (p_image.m_buffer.m_begin != l_image_buffer.m_data.m_begin) {
+      __copy_image(p_image, l_image_buffer);
+    }
+    (*l_present)->handoff();
   };
 
   window_native_ptr window_get_native_ptr(window_handle p_window) {
@@ -74,10 +250,29 @@ public:
     return *l_native_ptr;
   };
 
+  // Image buffer of the last drawn frame.
   window_image_buffer &window_get_image_buffer(window_handle p_window) {
-    window_image_buffer *l_image_buffer;
-    m_window_table.at(p_window.m_idx, none(), &l_image_buffer);
-    return *l_image_buffer;
+    window_present **l_present;
+    m_window_table.at(p_window.m_idx, none(), &l_present);
+    return (*l_present)->last();
+  };
+
+  // Image buffer where the next drawn frame can be rendered in place.
+  window_image_buffer &window_get_back_image_buffer(window_handle p_window) {
+    window_present **l_present;
+    m_window_table.at(p_window.m_idx, none(), &l_present);
+    return (*l_present)->back();
+  };
+
+  present_stats window_get_present_stats(window_handle p_window) {
+    window_present **l_present;
+    m_window_table.at(p_window.m_idx, none(), &l_present);
+    return (*l_present)->stats();
+  };
+
+  // Filter used when the drawn image is stretched to the window size.
+  void set_present_filter(rast::image_stretch::filter p_filter) {
+    m_present_filter = p_filter;
   };
 
   ui8 fetch_events() { return __fetch_events(); };
@@ -87,34 +282,51 @@ public:
 
 private:
   using window_table =
-      orm::table_pool_v2<window_native_ptr, window_image_buffer, win::events>;
+      orm::table_pool_v2<window_native_ptr, window_present *, win::events>;
 
   window_table m_window_table;
 
   container::vector<eng::input::Event> m_input_system_events;
 
-  void __allocate() {
+  rast::image_stretch m_stretch;
+  rast::image_stretch::filter m_present_filter;
+  thread_pool m_present_workers;
+
+  void __allocate(ui16 p_worker_count) {
     m_window_table.allocate(0);
     m_input_system_events.allocate(0);
+    m_stretch.allocate();
+    m_present_filter = rast::image_stretch::filter::Nearest;
+    m_present_workers.allocate(p_worker_count);
   };
 
   void __free() {
     assert_debug(!m_window_table.has_allocated_elements());
     m_window_table.free();
     m_input_system_events.free();
+    m_stretch.free();
+    m_present_workers.free();
+  };
+
+  // 32 bits frames are in s_window_image_format.
+  void __copy_image(const rast::image_view &p_image,
+                    window_image_buffer &p_image_buffer) {
+    rast::image_view l_target = p_image_buffer.image_view();
+    m_stretch.copy(p_image, l_target, m_present_filter, m_present_workers);
   };
 
   window_handle __create_window(ui16 p_width, ui16 p_height) {
     window_native_ptr l_native_ptr;
-    window_image_buffer l_image_buffer;
+    // The present thread holds the address of the present state.
+    window_present *l_present = new window_present();
     win::events l_events;
     l_native_ptr = {win::create_window(p_width, p_height)};
-    l_image_buffer.allocate(l_native_ptr, p_width, p_height);
+    l_present->allocate(l_native_ptr, p_width, p_height);
     l_events.m_window = l_native_ptr.m_ptr;
     l_events.allocate();
 
     uimax l_index =
-        m_window_table.push_back(l_native_ptr, l_image_buffer, l_events);
+        m_window_table.push_back(l_native_ptr, l_present, l_events);
     return {l_index};
   };
 
@@ -126,12 +338,12 @@ private:
 
   void __close_window(window_handle p_window) {
     window_native_ptr *l_native_ptr;
-    window_image_buffer *l_image_buffer;
+    window_present **l_present;
     win::events *l_events;
-    m_window_table.at(p_window.m_idx, &l_native_ptr, &l_image_buffer,
-                      &l_events);
+    m_window_table.at(p_window.m_idx, &l_native_ptr, &l_present, &l_events);
+    (*l_present)->free();
+    delete *l_present;
     win::close_window(l_native_ptr->m_ptr);
-    l_image_buffer->free();
     l_events->free();
     m_window_table.remove_at(p_window.m_idx);
     return;
@@ -142,10 +354,9 @@ private:
 
     window_handle l_handle = {0};
     window_native_ptr *l_native_ptr;
-    window_image_buffer *l_image_buffer;
+    window_present **l_present;
     win::events *l_events;
-    m_window_table.at(l_handle.m_idx, &l_native_ptr, &l_image_buffer,
-                      &l_events);
+    m_window_table.at(l_handle.m_idx, &l_native_ptr, &l_present, &l_events);
 
     {
       auto l_events_for_fetch =
@@ -166,11 +377,11 @@ private:
         l_input_event.m_flag = eng::input::Event::Flag::RELEASED;
         m_input_system_events.push_back(l_input_event);
       } else if (l_event.m_type == win::event::type::Redraw) {
-        if (l_event.m_draw.m_width != l_image_buffer->m_width &&
-            l_event.m_draw.m_height != l_image_buffer->m_height) {
-          l_image_buffer->free();
-          l_image_buffer->allocate(*l_native_ptr, l_event.m_draw.m_width,
-                                   l_event.m_draw.m_height);
+        window_image_buffer &l_image_buffer = (*l_present)->back();
+        if (l_event.m_draw.m_width != l_image_buffer.m_width ||
+            l_event.m_draw.m_height != l_image_buffer.m_height) {
+          (*l_present)->resize(l_event.m_draw.m_width,
+                               l_event.m_draw.m_height);
         }
       } else if (l_event.m_type == win::event::type::Close) {
         __close_window(l_handle);
@@ -30,6 +30,38 @@ template <typename T> fix32 magnitude(const vec<T, 3> &thiz) {
   return m::sqrt(dot(thiz, thiz));
 };
 
+// Magnitude rounded up, the squares are summed on 64 bits so that large
+// components don't overflow. Saturates to the largest fix32.
+inline fix32 magnitude_ceil(const vec<fix32, 3> &thiz) {
+  ui64 l_remainder = 0;
+  for (auto i = 0; i < 3; ++i) {
+    i64 l_value = thiz.at(i).m_value;
+    l_remainder += ui64(l_value * l_value);
+  }
+
+  ui64 l_root = 0;
+  ui64 l_bit = ui64(1) << 62;
+  while (l_bit > l_remainder) {
+    l_bit >>= 2;
+  }
+  while (l_bit != 0) {
+    if (l_remainder >= l_root + l_bit) {
+      l_remainder -= l_root + l_bit;
+      l_root = (l_root >> 1) + l_bit;
+    } else {
+      l_root >>= 1;
+    }
+    l_bit >>= 2;
+  }
+  if (l_remainder != 0) {
+    l_root += 1;
+  }
+
+  fix32 l_magnitude;
+  l_magnitude.m_value = l_root > ui64(0x7FFFFFFF) ? 0x7FFFFFFF : i32(l_root);
+  return l_magnitude;
+};
+
 template <typename T> vec<T, 3> normalize(const vec<T, 3> &thiz) {
   return thiz / magnitude(thiz);
 };
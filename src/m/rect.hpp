@@ -120,10 +120,18 @@ m::rect_min_max<T> fit_into(const m::rect_min_max<T> &p_rect,
     l_rect.min().y() = (p_into.point().y() + p_into.extend().y());
   }
 
+  if (l_rect.max().x() < p_into.point().x()) {
+    l_rect.max().x() = p_into.point().x();
+  }
+
   if (l_rect.max().x() > (p_into.point().x() + p_into.extend().x())) {
     l_rect.max().x() = (p_into.point().x() + p_into.extend().x());
   }
 
+  if (l_rect.max().y() < p_into.point().y()) {
+    l_rect.max().y() = p_into.point().y();
+  }
+
   if (l_rect.max().y() > (p_into.point().y() + p_into.extend().y())) {
     l_rect.max().y() = (p_into.point().y() + p_into.extend().y());
   }
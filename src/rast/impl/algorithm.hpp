@@ -8,8 +8,14 @@
 #include <m/rect.hpp>
 #include <rast/model.hpp>
 #include <shared/types.hpp>
+#include <sys/thread.hpp>
 
-#define TODO_NEAR_FAR_CLIPPING 0
+#if !PLATFORM_WEBASSEMBLY_PREPROCESS && defined(__SSE2__)
+#define RAST_EDGE_KERNEL_SSE2 1
+#include <emmintrin.h>
+#else
+#define RAST_EDGE_KERNEL_SSE2 0
+#endif
 
 namespace rast {
 
@@ -19,7 +25,6 @@ using screen_coord_t = i16;
 using polygon_vertex_indices = m::polygon<uimax, 3>;
 using pixel_coordinates = m::vec<screen_coord_t, 2>;
 using homogeneous_coordinates = position_t;
-using rasterization_weight = m::vec<fix32, 3>;
 using screen_polygon = m::polygon<m::vec<screen_coord_t, 2>, 3>;
 using screen_polygon_bounding_box = m::rect_min_max<screen_coord_t>;
 using screen_polygon_area = i32;
@@ -32,6 +37,9 @@ struct render_state {
   ui8 m_depth_write;
   ui8 m_depth_read;
   CullMode m_cull_mode;
+  // The color of a pixel only depends on the last polygon that passed the depth
+  // test.
+  ui8 m_opaque;
 
   static render_state from_int(ui64 p_state) {
     render_state l_state;
@@ -61,6 +69,8 @@ struct render_state {
     } else {
       l_state.m_cull_mode = CullMode::None;
     }
+
+    l_state.m_opaque = (p_state & BGFX_STATE_BLEND_MASK) == 0;
     return l_state;
   };
 };
@@ -68,10 +78,15 @@ struct render_state {
 struct index_buffer_const_view {
   ui8 m_index_byte_size;
   uimax m_index_count;
+  // Smallest and greatest vertex index referenced by the buffer.
+  vindex_t m_min_index;
+  vindex_t m_max_index;
   const container::range<ui8> &m_buffer;
 
-  index_buffer_const_view(const container::range<ui8> &p_buffer)
-      : m_buffer(p_buffer) {
+  index_buffer_const_view(const container::range<ui8> &p_buffer,
+                          vindex_t p_min_index, vindex_t p_max_index)
+      : m_min_index(p_min_index), m_max_index(p_max_index),
+        m_buffer(p_buffer) {
     m_index_byte_size = sizeof(vindex_t);
     m_index_count = m_buffer.count() / m_index_byte_size;
   };
@@ -91,12 +106,120 @@ using program_uniforms = container::range<void *>;
 
 struct utils {
 
+  // Per polygon constants used to test s_width consecutive pixels of a row at
+  // once. The SSE2 kernel is used when available, otherwise pixels are tested
+  // one by one.
+  struct edge_kernel {
+    inline static constexpr screen_coord_t s_width = 4;
+
+    pixel_coordinates m_d0;
+    pixel_coordinates m_d1;
+    pixel_coordinates m_d2;
+
+#if RAST_EDGE_KERNEL_SSE2
+    __m128i m_lane_steps_0;
+    __m128i m_lane_steps_1;
+    __m128i m_lane_steps_2;
+#endif
+
+    static edge_kernel make(const pixel_coordinates &p_d0,
+                            const pixel_coordinates &p_d1,
+                            const pixel_coordinates &p_d2) {
+      edge_kernel l_kernel;
+      l_kernel.m_d0 = p_d0;
+      l_kernel.m_d1 = p_d1;
+      l_kernel.m_d2 = p_d2;
+#if RAST_EDGE_KERNEL_SSE2
+      l_kernel.m_lane_steps_0 = __lane_steps(p_d0.y());
+      l_kernel.m_lane_steps_1 = __lane_steps(p_d1.y());
+      l_kernel.m_lane_steps_2 = __lane_steps(p_d2.y());
+#endif
+      return l_kernel;
+    };
+
+    // Calls p_cb for the covered pixels among the p_count (<= s_width) pixels
+    // starting at (p_x, p_y). ex0, ex1 and ex2 are the edge values of the
+    // first pixel.
+    template <ui8 PixelTest, typename CallbackFunc>
+    void rasterize_span(screen_coord_t p_x, screen_coord_t p_y,
+                        screen_coord_t p_count, screen_polygon_area ex0,
+                        screen_polygon_area ex1, screen_polygon_area ex2,
+                        const CallbackFunc &p_cb) const {
+      assert_debug(p_count <= s_width);
+      ui32 l_coverage = (1 << p_count) - 1;
+      if constexpr (PixelTest) {
+#if RAST_EDGE_KERNEL_SSE2
+        __m128i l_e0 = _mm_add_epi32(_mm_set1_epi32(ex0), m_lane_steps_0);
+        __m128i l_e1 = _mm_add_epi32(_mm_set1_epi32(ex1), m_lane_steps_1);
+        __m128i l_e2 = _mm_add_epi32(_mm_set1_epi32(ex2), m_lane_steps_2);
+        __m128i l_signs = _mm_or_si128(l_e0, _mm_or_si128(l_e1, l_e2));
+        l_coverage &= ~ui32(_mm_movemask_ps(_mm_castsi128_ps(l_signs)));
+#else
+        for (auto i = 0; i < p_count; ++i) {
+          if (ex0 < 0 || ex1 < 0 || ex2 < 0) {
+            l_coverage &= ~ui32(1 << i);
+          }
+          ex0 += m_d0.y();
+          ex1 += m_d1.y();
+          ex2 += m_d2.y();
+        }
+#endif
+      }
+
+      for (auto i = 0; i < p_count; ++i) {
+        if (l_coverage & (1 << i)) {
+          p_cb(screen_coord_t(p_x + i), p_y);
+        }
+      }
+    };
+
+  private:
+#if RAST_EDGE_KERNEL_SSE2
+    static __m128i __lane_steps(screen_coord_t p_step) {
+      return _mm_set_epi32(3 * p_step, 2 * p_step, p_step, 0);
+    };
+#endif
+  };
+
+  // The bounding rect is walked by blocks of s_block_size * s_block_size
+  // pixels, aligned on multiples of s_block_size in screen space. Edge
+  // functions are first evaluated at the block corners, blocks outside of the
+  // polygon are skipped and blocks inside of it are emitted without any per
+  // pixel edge test. Pixels are emitted block by block.
+  inline static constexpr screen_coord_t s_block_size = 8;
+
+  struct block {
+    screen_coord_t m_x;
+    screen_coord_t m_y;
+    screen_coord_t m_width;
+    screen_coord_t m_height;
+    // Edge function values at the corner pixels, in the order (min, min),
+    // (max, min), (min, max), (max, max).
+    screen_polygon_area m_e0[4];
+    screen_polygon_area m_e1[4];
+    screen_polygon_area m_e2[4];
+  };
+
   template <typename CallbackFunc>
   static void
-  rasterize_polygon_weighted(const screen_polygon &p_polygon,
-                             const screen_polygon_area &p_polygon_area,
-                             m::rect_min_max<screen_coord_t> &p_bounding_rect,
-                             const CallbackFunc &p_cb) {
+  rasterize_polygon(const screen_polygon &p_polygon,
+                    const screen_polygon_area &p_polygon_area,
+                    const m::rect_min_max<screen_coord_t> &p_bounding_rect,
+                    const CallbackFunc &p_cb) {
+    rasterize_polygon(
+        p_polygon, p_polygon_area, p_bounding_rect,
+        [](const block &, const auto &p_rasterize) { p_rasterize(); }, p_cb);
+  };
+
+  // p_block_cb(block, rasterize) is called for every block that overlaps the
+  // polygon. The block pixels are emitted only if it calls rasterize(), so it
+  // can reject a whole block or run code once the block is done.
+  template <typename BlockCallbackFunc, typename CallbackFunc>
+  static void rasterize_polygon(
+      const screen_polygon &p_polygon,
+      const screen_polygon_area &p_polygon_area,
+      const m::rect_min_max<screen_coord_t> &p_bounding_rect,
+      const BlockCallbackFunc &p_block_cb, const CallbackFunc &p_cb) {
     assert_debug(p_polygon_area > 0);
 
     pixel_coordinates l_pixel = {p_bounding_rect.min().x(),
@@ -109,31 +232,59 @@ struct utils {
     screen_polygon_area ey1 = __ey_calculation(l_pixel, p_polygon.p1(), d1);
     screen_polygon_area ey2 = __ey_calculation(l_pixel, p_polygon.p2(), d2);
 
-    for (auto y = p_bounding_rect.min().y(); y < p_bounding_rect.max().y();
-         ++y) {
+    const edge_kernel l_kernel = edge_kernel::make(d0, d1, d2);
+
+    block l_block;
+    for (l_block.m_y = p_bounding_rect.min().y();
+         l_block.m_y < p_bounding_rect.max().y();
+         l_block.m_y += l_block.m_height) {
+      l_block.m_height =
+          __block_extent(l_block.m_y, p_bounding_rect.max().y());
+
       screen_polygon_area ex0 = ey0;
       screen_polygon_area ex1 = ey1;
       screen_polygon_area ex2 = ey2;
 
-      for (auto x = p_bounding_rect.min().x(); x < p_bounding_rect.max().x();
-           ++x) {
-
-        if (ex0 >= 0 && ex1 >= 0 && ex2 >= 0) {
-          fix32 w0 = (fix32)ex2 / p_polygon_area;
-          fix32 w1 = (fix32)ex0 / p_polygon_area;
-          fix32 w2 = (fix32)ex1 / p_polygon_area;
-          assert_debug(w0 + w1 + w2 <= 1.01f);
-          p_cb(x, y, w0, w1, w2);
+      for (l_block.m_x = p_bounding_rect.min().x();
+           l_block.m_x < p_bounding_rect.max().x();
+           l_block.m_x += l_block.m_width) {
+        l_block.m_width =
+            __block_extent(l_block.m_x, p_bounding_rect.max().x());
+
+        __block_corners(ex0, d0, l_block.m_width, l_block.m_height,
+                        l_block.m_e0);
+        __block_corners(ex1, d1, l_block.m_width, l_block.m_height,
+                        l_block.m_e1);
+        __block_corners(ex2, d2, l_block.m_width, l_block.m_height,
+                        l_block.m_e2);
+
+        block_coverage l_coverage =
+            __min(__block_coverage(l_block.m_e0),
+                  __min(__block_coverage(l_block.m_e1),
+                        __block_coverage(l_block.m_e2)));
+
+        if (l_coverage == block_coverage::Inside) {
+          p_block_cb(l_block, [&]() {
+            __rasterize_block<0>(l_kernel, l_block.m_x, l_block.m_y,
+                                 l_block.m_width, l_block.m_height, ex0, ex1,
+                                 ex2, p_cb);
+          });
+        } else if (l_coverage == block_coverage::Partial) {
+          p_block_cb(l_block, [&]() {
+            __rasterize_block<1>(l_kernel, l_block.m_x, l_block.m_y,
+                                 l_block.m_width, l_block.m_height, ex0, ex1,
+                                 ex2, p_cb);
+          });
         }
 
-        ex0 += d0.y();
-        ex1 += d1.y();
-        ex2 += d2.y();
+        ex0 += d0.y() * l_block.m_width;
+        ex1 += d1.y() * l_block.m_width;
+        ex2 += d2.y() * l_block.m_width;
       }
 
-      ey0 -= d0.x();
-      ey1 -= d1.x();
-      ey2 -= d2.x();
+      ey0 -= d0.x() * l_block.m_height;
+      ey1 -= d1.x() * l_block.m_height;
+      ey2 -= d2.x() * l_block.m_height;
     }
   };
 
@@ -155,6 +306,82 @@ struct utils {
   };
 
 private:
+  enum class block_coverage { Outside = 0, Partial = 1, Inside = 2 };
+
+  static block_coverage __min(block_coverage p_left, block_coverage p_right) {
+    return p_left < p_right ? p_left : p_right;
+  };
+
+  // Distance from p_begin to the next block boundary, clipped to p_end.
+  static screen_coord_t __block_extent(screen_coord_t p_begin,
+                                       screen_coord_t p_end) {
+    screen_coord_t l_extent = s_block_size - (p_begin % s_block_size);
+    if (p_begin + l_extent > p_end) {
+      l_extent = p_end - p_begin;
+    }
+    return l_extent;
+  };
+
+  static void __block_corners(screen_polygon_area p_e,
+                              const pixel_coordinates &p_delta,
+                              screen_coord_t p_block_width,
+                              screen_coord_t p_block_height,
+                              screen_polygon_area (&out_corners)[4]) {
+    out_corners[0] = p_e;
+    out_corners[1] =
+        p_e + (screen_polygon_area(p_block_width - 1) * p_delta.y());
+    out_corners[2] =
+        p_e - (screen_polygon_area(p_block_height - 1) * p_delta.x());
+    out_corners[3] = out_corners[1] -
+                     (screen_polygon_area(p_block_height - 1) * p_delta.x());
+  };
+
+  // The edge function is linear, its extremums over the block are at the
+  // corners.
+  static block_coverage
+  __block_coverage(const screen_polygon_area (&p_corners)[4]) {
+    ui8 l_inside_count = (p_corners[0] >= 0) + (p_corners[1] >= 0) +
+                         (p_corners[2] >= 0) + (p_corners[3] >= 0);
+    if (l_inside_count == 0) {
+      return block_coverage::Outside;
+    } else if (l_inside_count == 4) {
+      return block_coverage::Inside;
+    }
+    return block_coverage::Partial;
+  };
+
+  template <ui8 PixelTest, typename CallbackFunc>
+  static void
+  __rasterize_block(const edge_kernel &p_kernel, screen_coord_t p_x,
+                    screen_coord_t p_y, screen_coord_t p_width,
+                    screen_coord_t p_height, screen_polygon_area ey0,
+                    screen_polygon_area ey1, screen_polygon_area ey2,
+                    const CallbackFunc &p_cb) {
+    const screen_coord_t l_span_width = edge_kernel::s_width;
+    for (auto y = p_y; y < p_y + p_height; ++y) {
+      screen_polygon_area ex0 = ey0;
+      screen_polygon_area ex1 = ey1;
+      screen_polygon_area ex2 = ey2;
+
+      for (auto x = p_x; x < p_x + p_width; x += l_span_width) {
+        screen_coord_t l_span_count = (p_x + p_width) - x;
+        if (l_span_count > l_span_width) {
+          l_span_count = l_span_width;
+        }
+        p_kernel.rasterize_span<PixelTest>(x, y, l_span_count, ex0, ex1, ex2,
+                                           p_cb);
+
+        ex0 += p_kernel.m_d0.y() * l_span_width;
+        ex1 += p_kernel.m_d1.y() * l_span_width;
+        ex2 += p_kernel.m_d2.y() * l_span_width;
+      }
+
+      ey0 -= p_kernel.m_d0.x();
+      ey1 -= p_kernel.m_d1.x();
+      ey2 -= p_kernel.m_d2.x();
+    }
+  };
+
   static screen_polygon_area
   __ey_calculation(const pixel_coordinates &p_pixel,
                    const pixel_coordinates &p_polygon_point,
@@ -166,28 +393,301 @@ private:
   };
 };
 
+// An attribute of the polygon as a plane in screen space. It is set up once per
+// polygon, a pixel value then costs one multiply-add per axis.
+//
+// The plane is kept with s_precision fractional bits below the fix32 unit and a
+// pixel gets the fix32 nearest to it, halves rounded up. Gradients are rounded
+// to nearest, their error adds at most 2^-s_precision fix32 unit per pixel of
+// distance to the first vertex. So pixels are the exactly interpolated value up
+// to rounding, where the sum of three rounded weight * value products was used
+// before, outputs can differ from it by a few fix32 units.
+struct attribute_plane {
+  inline static constexpr ui8 s_precision = 16;
+
+  pixel_coordinates m_origin;
+  i64 m_value;
+  i64 m_ddx;
+  i64 m_ddy;
+
+  // The weight of a vertex is the edge function of the opposite edge divided by
+  // the area, as set up by utils::rasterize_polygon.
+  static attribute_plane make(const screen_polygon &p_polygon,
+                              screen_polygon_area p_area, fix32 p_0, fix32 p_1,
+                              fix32 p_2) {
+    assert_debug(p_area > 0);
+    const pixel_coordinates d0 = p_polygon.p0() - p_polygon.p2();
+    const pixel_coordinates d1 = p_polygon.p1() - p_polygon.p0();
+    const pixel_coordinates d2 = p_polygon.p2() - p_polygon.p1();
+
+    i64 l_ddx = (i64(d2.y()) * p_0.m_value) + (i64(d0.y()) * p_1.m_value) +
+                (i64(d1.y()) * p_2.m_value);
+    i64 l_ddy = -((i64(d2.x()) * p_0.m_value) + (i64(d0.x()) * p_1.m_value) +
+                  (i64(d1.x()) * p_2.m_value));
+
+    // Values are signed, they are scaled by a multiplication rather than a
+    // left shift.
+    const i64 l_scale = i64(1) << s_precision;
+    attribute_plane l_plane;
+    l_plane.m_origin = p_polygon.p0();
+    l_plane.m_value = i64(p_0.m_value) * l_scale;
+    l_plane.m_ddx = __div_nearest(l_ddx * l_scale, p_area);
+    l_plane.m_ddy = __div_nearest(l_ddy * l_scale, p_area);
+    return l_plane;
+  };
+
+  fix32 at(screen_coord_t p_x, screen_coord_t p_y) const {
+    i64 l_value = m_value + (m_ddx * (p_x - m_origin.x())) +
+                  (m_ddy * (p_y - m_origin.y()));
+    fix32 l_fix;
+    l_fix.m_value = i32((l_value + (i64(1) << (s_precision - 1))) >> s_precision);
+    return l_fix;
+  };
+
+private:
+  static i64 __div_nearest(i64 p_numerator, i64 p_denominator) {
+    if (p_numerator >= 0) {
+      return (p_numerator + (p_denominator / 2)) / p_denominator;
+    }
+    return (p_numerator - (p_denominator / 2)) / p_denominator;
+  };
+};
+
+// Coarse depth target made of the max depth of s_cell_size square cells. A cell
+// is never lower than any depth of the cell, it is only lowered when a whole
+// cell is written. Cells are the rasterization blocks so that a block is depth
+// rejected with a single read.
+struct depth_max {
+  inline static constexpr screen_coord_t s_cell_size = utils::s_block_size;
+
+  static ui16 cell_count(ui16 p_pixel_count) {
+    return (p_pixel_count + s_cell_size - 1) / s_cell_size;
+  };
+};
+
+using clip_coordinates = m::vec<fix32, 4>;
+using clip_code_t = ui8;
+// Plane distances have the precision of fix32 but are 64 bits wide, w times the
+// guard band scale overflows fix32 once w is larger than a few thousands.
+using clip_distance_t = i64;
+
+// Homogeneous clipping against the near and far planes and a guard band around
+// the viewport. Vertices inside of the guard band have pixel coordinates that
+// fit in i16 and edge functions that fit in screen_polygon_area, so polygons
+// are clipped only when they cross the near, far or guard band planes. Pixels
+// outside of the viewport are then rejected by the bounding rect.
+struct clip {
+  // Pixels of guard band on each side of the viewport.
+  inline static constexpr i32 s_guard_band = 4096;
+
+  inline static constexpr ui8 s_near = 0;
+  inline static constexpr ui8 s_far = 1;
+  inline static constexpr ui8 s_left = 2;
+  inline static constexpr ui8 s_right = 3;
+  inline static constexpr ui8 s_bottom = 4;
+  inline static constexpr ui8 s_top = 5;
+  inline static constexpr ui8 s_plane_count = 6;
+
+  // Every plane adds at most one vertex to a convex polygon.
+  inline static constexpr ui8 s_max_vertex_count = 3 + s_plane_count;
+  // Every plane creates at most two vertices.
+  inline static constexpr ui8 s_max_created_vertex_count = 2 * s_plane_count;
+
+  // A position is inside of the guard band when |x| <= scale.x * w and
+  // |y| <= scale.y * w.
+  static m::vec<fix32, 2> guard_band_scale(const m::vec<ui16, 2> &p_extend) {
+    m::vec<fix32, 2> l_scale;
+    for (auto i = 0; i < 2; ++i) {
+      ui16 l_pixel_extend = p_extend.at(i) > 1 ? p_extend.at(i) - 1 : 1;
+      l_scale.at(i) = fix32(1) + (fix32(2 * s_guard_band) / l_pixel_extend);
+    }
+    return l_scale;
+  };
+
+  // Signed distance of the position to the plane, the position is inside when
+  // it is positive or zero.
+  static clip_distance_t distance(ui8 p_plane,
+                                  const clip_coordinates &p_position,
+                                  const m::vec<fix32, 2> &p_guard_band_scale) {
+    clip_distance_t l_w = p_position.w().m_value;
+    switch (p_plane) {
+    case s_near:
+      return l_w + p_position.z().m_value;
+    case s_far:
+      return l_w - p_position.z().m_value;
+    case s_left:
+      return __scale(l_w, p_guard_band_scale.x()) + p_position.x().m_value;
+    case s_right:
+      return __scale(l_w, p_guard_band_scale.x()) - p_position.x().m_value;
+    case s_bottom:
+      return __scale(l_w, p_guard_band_scale.y()) + p_position.y().m_value;
+    case s_top:
+      return __scale(l_w, p_guard_band_scale.y()) - p_position.y().m_value;
+    }
+    sys::abort();
+    return 0;
+  };
+
+  // One bit per plane the position is outside of.
+  static clip_code_t code(const clip_coordinates &p_position,
+                          const m::vec<fix32, 2> &p_guard_band_scale) {
+    clip_code_t l_code = 0;
+    for (auto l_plane = 0; l_plane < s_plane_count; ++l_plane) {
+      if (distance(l_plane, p_position, p_guard_band_scale) < 0) {
+        l_code |= (1 << l_plane);
+      }
+    }
+    return l_code;
+  };
+
+  // Value at the intersection of an edge with a plane. Intersections are
+  // always computed from the inside vertex so that polygons sharing the edge
+  // get the same vertex.
+  static fix32 intersect(fix32 p_inside, fix32 p_outside,
+                         clip_distance_t p_inside_distance,
+                         clip_distance_t p_outside_distance) {
+    assert_debug(p_inside_distance >= 0 && p_outside_distance < 0);
+    clip_distance_t l_denominator = p_inside_distance - p_outside_distance;
+    // Distances are reduced with the same shift until the numerator fits in
+    // 64 bits, the ratio between them is kept.
+    while (l_denominator >= (clip_distance_t(1) << 30)) {
+      p_inside_distance >>= 1;
+      l_denominator >>= 1;
+    }
+    i64 l_numerator =
+        i64(i64(p_outside.m_value) - p_inside.m_value) * p_inside_distance;
+    fix32 l_value;
+    l_value.m_value = p_inside.m_value + i32(l_numerator / l_denominator);
+    return l_value;
+  };
+
+private:
+  // fix32 product of w by the scale, rounded like fix32.
+  static clip_distance_t __scale(clip_distance_t p_w, fix32 p_scale) {
+    return ((p_w * p_scale.m_value) + (fix32::scale >> 1)) >>
+           fix32::scale_factor;
+  };
+};
+
+// Conservative test of a draw against the planes of the view frustum, the guard
+// band is not part of it.
+struct frustum {
+
+  static ui8 is_outside(const m::mat<fix32, 4, 4> &p_local_to_clip,
+                        const bounding_volume &p_bounds) {
+    const m::vec<fix32, 2> l_scale = {1, 1};
+
+    // The sphere is tested first, the box only when the sphere crosses a
+    // plane.
+    clip_coordinates l_center =
+        p_local_to_clip * clip_coordinates{p_bounds.m_center.x(),
+                                           p_bounds.m_center.y(),
+                                           p_bounds.m_center.z(), 1};
+    ui8 l_inside = 1;
+    for (auto l_plane = 0; l_plane < clip::s_plane_count; ++l_plane) {
+      // Plane distances are not normalized, the radius is scaled by the
+      // length of the plane normal in local space.
+      position_t l_normal;
+      for (auto i = 0; i < 3; ++i) {
+        l_normal.at(i).m_value =
+            i32(clip::distance(l_plane, p_local_to_clip.m_data[i], l_scale));
+      }
+      fix32 l_radius = p_bounds.m_radius * m::magnitude_ceil(l_normal);
+      clip_distance_t l_distance = clip::distance(l_plane, l_center, l_scale);
+      if (l_distance < -clip_distance_t(l_radius.m_value)) {
+        return 1;
+      }
+      if (l_distance < l_radius.m_value) {
+        l_inside = 0;
+      }
+    }
+    if (l_inside) {
+      return 0;
+    }
+
+    clip_code_t l_code = clip_code_t(-1);
+    for (auto l_corner = 0; l_corner < 8; ++l_corner) {
+      clip_coordinates l_position;
+      for (auto i = 0; i < 3; ++i) {
+        l_position.at(i) = (l_corner & (1 << i)) ? p_bounds.m_max.at(i)
+                                                 : p_bounds.m_min.at(i);
+      }
+      l_position.at(3) = 1;
+      l_code &= clip::code(p_local_to_clip * l_position, l_scale);
+    }
+    return l_code != 0;
+  };
+};
+
 using per_vertices_t =
-    orm::table_span_v2<pixel_coordinates, homogeneous_coordinates>;
+    orm::table_span_v2<pixel_coordinates, homogeneous_coordinates,
+                       clip_coordinates, clip_code_t>;
 
 using per_polygons_t =
     orm::table_span_v2<screen_polygon, polygon_vertex_indices,
                        screen_polygon_bounding_box, screen_polygon_area>;
 
-using visibility_bool_t = ui8;
-using visibility_polygon_index_t = uimax;
-using visibility = orm::table_span_v2<visibility_bool_t, rasterization_weight,
-                                      visibility_polygon_index_t>;
+// A pixel of the visibility buffer is a single word, 0 when no polygon is
+// visible, otherwise the index of the visible polygon with s_visible_bit set.
+struct visibility {
+  using word_t = ui32;
+  inline static constexpr word_t s_visible_bit = word_t(1) << 31;
+
+  static word_t make(uimax p_polygon_index) {
+    assert_debug(p_polygon_index < s_visible_bit);
+    return word_t(p_polygon_index) | s_visible_bit;
+  };
+
+  static ui8 is_visible(word_t p_word) {
+    return (p_word & s_visible_bit) != 0;
+  };
+
+  static uimax polygon_index(word_t p_word) {
+    assert_debug(is_visible(p_word));
+    return p_word & ~s_visible_bit;
+  };
+};
 
 struct rasterize_heap {
 
+  // Polygons are binned into square screen tiles that are rasterized
+  // independently. A tile owns its pixels in the visibility, color and depth
+  // buffers, so tiles can be processed concurrently.
+  inline static constexpr screen_coord_t s_tile_size = 64;
+
   per_vertices_t m_per_vertices;
   per_polygons_t m_per_polygons;
 
   container::multi_byte_buffer m_vertex_output;
-  container::span<ui8 *> m_vertex_output_send_to_vertex_shader;
 
-  visibility m_visibility_buffer;
-  visibility m_rasterizationrect_visibility_buffer;
+  // Vertices are shaded in chunks of contiguous vertices, one task per chunk.
+  inline static constexpr uimax s_vertex_chunk_size =
+      16 * shader_vertex_bytes::s_batch_size;
+
+  // Triangles of the index buffer are extracted in chunks, one task per chunk.
+  // A chunk writes its polygons from m_polygon_begin and the vertices created
+  // by clipping from m_vertex_begin, both sized for the worst case. Polygons
+  // are then compacted in chunk order, so the output does not depend on the
+  // worker count.
+  inline static constexpr uimax s_polygon_chunk_size = 1024;
+  struct polygon_chunk {
+    uimax m_clipped_count;
+    uimax m_vertex_begin;
+    uimax m_vertex_count;
+    uimax m_polygon_begin;
+    uimax m_polygon_count;
+  };
+  container::span<polygon_chunk> m_polygon_chunks;
+
+  // On demand vertex shading. m_vertex_marks flags the vertices of the
+  // referenced index range that are already listed, m_vertex_indices lists
+  // every referenced vertex once, in the order of the index buffer.
+  container::span<ui8> m_vertex_marks;
+  container::span<uimax> m_vertex_indices;
+  container::vector<frame_stats::vertex_shading> m_vertex_shading_stats;
+
+  // Pixels are reset to 0 once they are shaded, the buffer is never cleared.
+  container::span<visibility::word_t> m_visibility_buffer;
 
   struct vertex_output_layout {
 
@@ -195,39 +695,231 @@ struct rasterize_heap {
       ui16 m_element_size;
       bgfx::AttribType::Enum m_attrib_type;
       ui8 m_attrib_element_count;
+      // Index of the first component plane in a polygon planes.
+      ui16 m_plane_index;
     };
 
     container::span<layout> m_layout;
     ui8 m_col_count;
+    // Planes per polygon, the depth plane followed by the components of the
+    // float vertex outputs.
+    ui16 m_plane_count;
   } m_vertex_output_layout;
 
-  container::multi_byte_buffer m_vertex_output_interpolated;
-  container::span<ui8 *> m_vertex_output_interpolated_send_to_fragment_shader;
+  inline static constexpr ui16 s_depth_plane_index = 0;
+  container::span<attribute_plane> m_polygon_planes;
+
+  // Draws of a deferred render pass that are waiting for the resolve. Their
+  // polygon planes are appended to m_polygon_planes and stay there until the
+  // pass is resolved. The visibility buffer is shared by all of them, it holds
+  // polygon indices that count from the first deferred polygon.
+  struct deferred_draw {
+    void *m_fragment;
+    program_uniforms m_fragment_uniforms;
+    uimax m_polygon_begin;
+    uimax m_polygon_count;
+    uimax m_plane_begin;
+    uimax m_layout_begin;
+    ui8 m_col_count;
+    ui16 m_plane_count;
+    m::rect_min_max<ui16> m_rendered_rect;
+  };
+
+  struct deferred {
+    container::vector<deferred_draw> m_draws;
+    container::vector<vertex_output_layout::layout> m_layouts;
+    uimax m_polygon_count;
+    uimax m_plane_count;
+
+    void clear() {
+      m_draws.clear();
+      m_layouts.clear();
+      m_polygon_count = 0;
+      m_plane_count = 0;
+    };
+  } m_deferred;
+  frame_stats::deferred m_deferred_stats;
+  // Draws culled by the caller before reaching a rasterize_unit.
+  uimax m_culled_draws;
+
+  struct tiles {
+    ui16 m_count_x;
+    ui16 m_count_y;
+    // m_polygon_offsets[tile] to m_polygon_offsets[tile + 1] is the range of
+    // m_polygons rasterized by the tile. Polygons are kept in submission order.
+    container::span<uimax> m_polygon_offsets;
+    container::span<uimax> m_polygon_cursors;
+    container::span<uimax> m_polygons;
+    // Tiles that have at least one polygon.
+    container::span<uimax> m_rasterized;
+    uimax m_rasterized_count;
+  } m_tiles;
+
+  // Scratch memory owned by a single worker thread.
+  struct worker {
+    container::span<ui8 *> m_vertex_output_send_to_vertex_shader;
+    // Structure of arrays positions of a shader_vertex_batch_function call.
+    fix32 m_vertex_batch_positions[4][shader_vertex_bytes::s_batch_size];
+    // Vertices and vertex outputs of a batch of scattered vertices. Vertices
+    // are gathered before the shader_vertex_batch_function call and the
+    // outputs are scattered back to the vertex indices.
+    container::span<ui8> m_vertex_batch_input;
+    container::multi_byte_buffer m_vertex_batch_output;
+    container::span<ui8 *> m_vertex_output_interpolated_send_to_fragment_shader;
+    // Pixel indices of the tile with a visible polygon, each pixel is pushed
+    // once when its visibility is first set.
+    container::span<uimax> m_visible_pixels;
+    uimax m_visible_pixel_count;
+    // Interpolated vertex outputs of the span of visible pixels being shaded,
+    // one column of shader_fragment_bytes::s_batch_size values per vertex
+    // output. Spans are interpolated and shaded right away, so they stay in
+    // cache.
+    container::multi_byte_buffer m_span_vertex_output;
+    container::arr<rgb_t, shader_fragment_bytes::s_batch_size> m_span_colors;
+    frame_stats::depth_max m_depth_max_stats;
+    uimax m_deferred_shaded;
+  };
+  container::span<worker> m_workers;
 
-  void allocate() {
+  void allocate(uimax p_worker_count) {
     m_per_vertices.allocate(0);
     m_per_polygons.allocate(0);
+    m_polygon_planes.allocate(0);
     m_visibility_buffer.allocate(0);
-    m_rasterizationrect_visibility_buffer.allocate(0);
     m_vertex_output.allocate();
-    m_vertex_output_interpolated.allocate();
 
-    m_vertex_output_send_to_vertex_shader.allocate(128);
-    m_vertex_output_interpolated_send_to_fragment_shader.allocate(128);
+    m_polygon_chunks.allocate(0);
     m_vertex_output_layout.m_layout.allocate(128);
+    m_vertex_marks.allocate(0);
+    m_vertex_indices.allocate(0);
+    m_vertex_shading_stats.allocate(0);
+
+    m_deferred.m_draws.allocate(0);
+    m_deferred.m_layouts.allocate(0);
+    m_deferred.clear();
+    m_deferred_stats.reset();
+    m_culled_draws = 0;
+
+    m_tiles.m_count_x = 0;
+    m_tiles.m_count_y = 0;
+    m_tiles.m_polygon_offsets.allocate(0);
+    m_tiles.m_polygon_cursors.allocate(0);
+    m_tiles.m_polygons.allocate(0);
+    m_tiles.m_rasterized.allocate(0);
+    m_tiles.m_rasterized_count = 0;
+
+    m_workers.allocate(p_worker_count);
+    for (auto i = 0; i < m_workers.count(); ++i) {
+      worker &l_worker = m_workers.at(i);
+      l_worker.m_vertex_output_send_to_vertex_shader.allocate(128);
+      l_worker.m_vertex_batch_input.allocate(0);
+      l_worker.m_vertex_batch_output.allocate();
+      l_worker.m_vertex_output_interpolated_send_to_fragment_shader.allocate(
+          128);
+      l_worker.m_visible_pixels.allocate(s_tile_size * s_tile_size);
+      l_worker.m_visible_pixel_count = 0;
+      l_worker.m_span_vertex_output.allocate();
+      l_worker.m_depth_max_stats.reset();
+      l_worker.m_deferred_shaded = 0;
+    }
   };
 
   void free() {
     m_per_vertices.free();
     m_per_polygons.free();
+    m_polygon_planes.free();
     m_visibility_buffer.free();
-    m_rasterizationrect_visibility_buffer.free();
     m_vertex_output.free();
-    m_vertex_output_interpolated.free();
 
-    m_vertex_output_send_to_vertex_shader.free();
-    m_vertex_output_interpolated_send_to_fragment_shader.free();
+    m_polygon_chunks.free();
     m_vertex_output_layout.m_layout.free();
+    m_vertex_marks.free();
+    m_vertex_indices.free();
+    m_vertex_shading_stats.free();
+
+    m_deferred.m_draws.free();
+    m_deferred.m_layouts.free();
+
+    m_tiles.m_polygon_offsets.free();
+    m_tiles.m_polygon_cursors.free();
+    m_tiles.m_polygons.free();
+    m_tiles.m_rasterized.free();
+
+    for (auto i = 0; i < m_workers.count(); ++i) {
+      worker &l_worker = m_workers.at(i);
+      l_worker.m_vertex_output_send_to_vertex_shader.free();
+      l_worker.m_vertex_batch_input.free();
+      l_worker.m_vertex_batch_output.free();
+      l_worker.m_vertex_output_interpolated_send_to_fragment_shader.free();
+      l_worker.m_visible_pixels.free();
+      l_worker.m_span_vertex_output.free();
+    }
+    m_workers.free();
+  };
+
+  void reset_stats() {
+    for (auto i = 0; i < m_workers.count(); ++i) {
+      m_workers.at(i).m_depth_max_stats.reset();
+      m_workers.at(i).m_deferred_shaded = 0;
+    }
+    m_vertex_shading_stats.clear();
+    m_deferred_stats.reset();
+    m_culled_draws = 0;
+  };
+
+  // Adds the stats of the heap to p_stats.
+  void collect_stats(frame_stats &p_stats) {
+    p_stats.m_deferred.m_draws += m_deferred_stats.m_draws;
+    p_stats.m_deferred.m_shaded += m_deferred_stats.m_shaded;
+    p_stats.m_culled_draws += m_culled_draws;
+    for (auto i = 0; i < m_workers.count(); ++i) {
+      p_stats.m_depth_max.add(m_workers.at(i).m_depth_max_stats);
+      p_stats.m_deferred.m_shaded += m_workers.at(i).m_deferred_shaded;
+    }
+    for (auto i = 0; i < m_vertex_shading_stats.count(); ++i) {
+      p_stats.m_draws.push_back(m_vertex_shading_stats.at(i));
+    }
+  };
+
+  // Span columns of the workers, for the vertex output layout of the shaded
+  // draw.
+  void resize_shading_buffers(const vertex_output_layout::layout *p_layouts,
+                              ui8 p_col_count) {
+    for (auto l_worker_it = 0; l_worker_it < m_workers.count();
+         ++l_worker_it) {
+      worker &l_worker = m_workers.at(l_worker_it);
+      l_worker.m_vertex_output_interpolated_send_to_fragment_shader.resize(
+          p_col_count);
+      l_worker.m_span_vertex_output.resize_col_capacity(p_col_count);
+      for (auto l_col_it = 0; l_col_it < p_col_count; ++l_col_it) {
+        l_worker.m_span_vertex_output.col(l_col_it).resize(
+            shader_fragment_bytes::s_batch_size,
+            p_layouts[l_col_it].m_element_size);
+      }
+    }
+  };
+
+  void
+  resize_vertex_batch_buffers(const vertex_output_layout::layout *p_layouts,
+                              ui8 p_col_count, ui16 p_vertex_stride) {
+    for (auto l_worker_it = 0; l_worker_it < m_workers.count();
+         ++l_worker_it) {
+      worker &l_worker = m_workers.at(l_worker_it);
+      l_worker.m_vertex_batch_input.resize(shader_vertex_bytes::s_batch_size *
+                                           p_vertex_stride);
+      l_worker.m_vertex_batch_output.resize_col_capacity(p_col_count);
+      for (auto l_col_it = 0; l_col_it < p_col_count; ++l_col_it) {
+        l_worker.m_vertex_batch_output.col(l_col_it).resize(
+            shader_vertex_bytes::s_batch_size,
+            p_layouts[l_col_it].m_element_size);
+      }
+    }
+  };
+
+  void reset_visibility(const worker &p_worker) {
+    for (auto i = 0; i < p_worker.m_visible_pixel_count; ++i) {
+      m_visibility_buffer.at(p_worker.m_visible_pixels.at(i)) = 0;
+    }
   };
 
   pixel_coordinates &get_pixel_coordinates(ui32 p_index) {
@@ -241,6 +933,281 @@ struct rasterize_heap {
     m_per_vertices.at(p_index, none(), &l_homogeneous_coordinates);
     return *l_homogeneous_coordinates;
   };
+
+  clip_coordinates &get_clip_coordinates(uimax p_index) {
+    clip_coordinates *l_clip_coordinates;
+    m_per_vertices.at(p_index, none(), none(), &l_clip_coordinates);
+    return *l_clip_coordinates;
+  };
+
+  clip_code_t &get_clip_code(uimax p_index) {
+    clip_code_t *l_clip_code;
+    m_per_vertices.at(p_index, none(), none(), none(), &l_clip_code);
+    return *l_clip_code;
+  };
+};
+
+// Clears of a render target recorded per rasterize_heap tile. A pending tile is
+// cleared by the first draw that rasterizes it, the tiles that are not drawn
+// are cleared when the target is read. Tiles are filled by rows so that the
+// clear value is written with wide copies.
+struct target_clear {
+  inline static constexpr ui8 s_color = 1;
+  inline static constexpr ui8 s_depth = 2;
+
+  ui16 m_count_x;
+  ui16 m_count_y;
+  // s_color and s_depth bits of the tiles that are not cleared yet.
+  container::span<ui8> m_pending;
+  ui8 m_has_pending;
+  bgfx::TextureFormat::Enum m_color_format;
+  // Clear color as a pixel of m_color_format, see color_format.
+  ui32 m_color;
+  fix32 m_depth;
+
+  void allocate(ui16 p_width, ui16 p_height,
+                bgfx::TextureFormat::Enum p_color_format) {
+    assert_debug(color_format::is_supported(p_color_format));
+    m_color_format = p_color_format;
+    const auto l_tile_size = rasterize_heap::s_tile_size;
+    m_count_x = (p_width + l_tile_size - 1) / l_tile_size;
+    m_count_y = (p_height + l_tile_size - 1) / l_tile_size;
+    m_pending.allocate(m_count_x * m_count_y);
+    m_pending.range().zero();
+    m_has_pending = 0;
+  };
+
+  void free() { m_pending.free(); };
+
+  // The depth bit must only be set for targets with depth.
+  void clear(ui8 p_flags, const rgb_t &p_color, fix32 p_depth) {
+    if (p_flags == 0) {
+      return;
+    }
+    if (p_flags & s_color) {
+      m_color = color_format::pixel(m_color_format, p_color);
+    }
+    if (p_flags & s_depth) {
+      m_depth = p_depth;
+    }
+    for (auto i = 0; i < m_pending.count(); ++i) {
+      m_pending.at(i) |= p_flags;
+    }
+    m_has_pending = 1;
+  };
+
+  void materialize_tile(uimax p_tile_index, image_view &p_color,
+                        image_view &p_depth, image_view &p_depth_max) {
+    ui8 &l_pending = m_pending.at(p_tile_index);
+    if (l_pending == 0) {
+      return;
+    }
+
+    const auto l_tile_size = rasterize_heap::s_tile_size;
+    m::rect_min_max<ui16> l_rect;
+    l_rect.min() = {ui16((p_tile_index % m_count_x) * l_tile_size),
+                    ui16((p_tile_index / m_count_x) * l_tile_size)};
+    l_rect.max() = l_rect.min() + l_tile_size;
+    m::rect_point_extend<ui16> l_image_rect;
+    l_image_rect.point() = {0, 0};
+    l_image_rect.extend() = {p_color.m_width, p_color.m_height};
+    l_rect = m::fit_into(l_rect, l_image_rect);
+
+    if (l_pending & s_color) {
+      assert_debug(p_color.m_bits_per_pixel <= sizeof(m_color));
+      __fill(p_color, l_rect, (ui8 *)&m_color);
+    }
+    if (l_pending & s_depth) {
+      assert_debug(p_depth.m_bits_per_pixel == sizeof(m_depth));
+      __fill(p_depth, l_rect, (ui8 *)&m_depth);
+
+      // Tiles are made of whole depth_max cells.
+      m::rect_min_max<ui16> l_cell_rect;
+      l_cell_rect.min() = l_rect.min() / depth_max::s_cell_size;
+      l_cell_rect.max() = {depth_max::cell_count(l_rect.max().x()),
+                           depth_max::cell_count(l_rect.max().y())};
+      __fill(p_depth_max, l_cell_rect, (ui8 *)&m_depth);
+    }
+    l_pending = 0;
+  };
+
+  void materialize_all(image_view &p_color, image_view &p_depth,
+                       image_view &p_depth_max) {
+    if (!m_has_pending) {
+      return;
+    }
+    for (auto i = 0; i < m_pending.count(); ++i) {
+      materialize_tile(i, p_color, p_depth, p_depth_max);
+    }
+    m_has_pending = 0;
+  };
+
+private:
+  static void __fill(image_view &p_image, const m::rect_min_max<ui16> &p_rect,
+                     ui8 *p_pixel) {
+    const ui8 l_pixel_size = p_image.m_bits_per_pixel;
+    ui8 *l_first_row = p_image.at(p_rect.min().y(), p_rect.min().x());
+    for (auto x = 0; x < p_rect.max().x() - p_rect.min().x(); ++x) {
+      sys::memcpy(l_first_row + (x * l_pixel_size), p_pixel, l_pixel_size);
+    }
+    const uimax l_row_size =
+        (p_rect.max().x() - p_rect.min().x()) * l_pixel_size;
+    for (ui16 y = p_rect.min().y() + 1; y < p_rect.max().y(); ++y) {
+      sys::memcpy(p_image.at(y, p_rect.min().x()), l_first_row, l_row_size);
+    }
+  };
+};
+
+// Interpolation of the vertex outputs and fragment shading of the visible
+// pixels of a worker. Visibility polygon indices count from m_polygon_begin,
+// whose planes are at m_planes.
+struct shading_unit {
+  rasterize_heap &m_heap;
+  const rasterize_heap::vertex_output_layout::layout *m_layouts;
+  ui8 m_col_count;
+  ui16 m_plane_count;
+  const attribute_plane *m_planes;
+  uimax m_polygon_begin;
+  void *m_fragment;
+  program_uniforms m_fragment_uniforms;
+  image_view m_target_image_view;
+  bgfx::TextureFormat::Enum m_target_format;
+
+  // Visible pixels are consumed by spans of s_batch_size. The vertex outputs
+  // of a span are interpolated into the worker columns and shaded right away.
+  void shade(rasterize_heap::worker &p_worker) {
+    assert_debug(m_fragment);
+
+    shader_fragment_bytes::view l_fragment_view = {(ui8 *)m_fragment};
+    shader_fragment_batch_function l_fragment_batch =
+        l_fragment_view.batch_function();
+    shader_fragment_function l_fragment = l_fragment_view.fonction();
+
+    for (auto l_span_begin = 0; l_span_begin < p_worker.m_visible_pixel_count;
+         l_span_begin += shader_fragment_bytes::s_batch_size) {
+      uimax l_span_count = p_worker.m_visible_pixel_count - l_span_begin;
+      if (l_span_count > shader_fragment_bytes::s_batch_size) {
+        l_span_count = shader_fragment_bytes::s_batch_size;
+      }
+      const uimax *l_span_pixels =
+          p_worker.m_visible_pixels.m_data + l_span_begin;
+
+      __interpolate_vertex_output(l_span_pixels, l_span_count, p_worker);
+      if (l_fragment_batch) {
+        __fragment_span(l_fragment_batch, l_span_pixels, l_span_count,
+                        p_worker);
+      } else {
+        __fragment_span(l_fragment, l_span_pixels, l_span_count, p_worker);
+      }
+    }
+  };
+
+private:
+  const attribute_plane *__polygon_planes(uimax p_polygon_index) {
+    assert_debug(p_polygon_index >= m_polygon_begin);
+    return m_planes + ((p_polygon_index - m_polygon_begin) * m_plane_count);
+  };
+
+  void __interpolate_vertex_output(const uimax *p_span_pixels,
+                                   uimax p_span_count,
+                                   rasterize_heap::worker &p_worker) {
+    for (auto j = 0; j < m_col_count; ++j) {
+      const rasterize_heap::vertex_output_layout::layout &l_layout =
+          m_layouts[j];
+      if (l_layout.m_attrib_type != bgfx::AttribType::Float) {
+        continue;
+      }
+      switch (l_layout.m_attrib_element_count) {
+      case 1:
+        __interpolate_vertex_output_col<1>(p_span_pixels, p_span_count,
+                                           p_worker, j);
+        break;
+      case 2:
+        __interpolate_vertex_output_col<2>(p_span_pixels, p_span_count,
+                                           p_worker, j);
+        break;
+      case 3:
+        __interpolate_vertex_output_col<3>(p_span_pixels, p_span_count,
+                                           p_worker, j);
+        break;
+      case 4:
+        __interpolate_vertex_output_col<4>(p_span_pixels, p_span_count,
+                                           p_worker, j);
+        break;
+      default:
+        assert_debug(false);
+        break;
+      }
+    }
+  };
+
+  // The layout is resolved once per vertex output, the pixel loop is
+  // specialized on the element count.
+  template <ui8 ElementCount>
+  void __interpolate_vertex_output_col(const uimax *p_span_pixels,
+                                       uimax p_span_count,
+                                       rasterize_heap::worker &p_worker,
+                                       ui8 p_col_index) {
+    const ui16 l_width = m_target_image_view.m_width;
+    const ui16 l_plane_index = m_layouts[p_col_index].m_plane_index;
+    fix32 *l_span_col =
+        (fix32 *)p_worker.m_span_vertex_output.at(p_col_index, 0);
+
+    for (auto i = 0; i < p_span_count; ++i) {
+      const uimax l_pixel_index = p_span_pixels[i];
+      const attribute_plane *l_planes =
+          __polygon_planes(visibility::polygon_index(
+              m_heap.m_visibility_buffer.at(l_pixel_index))) +
+          l_plane_index;
+      screen_coord_t l_y = l_pixel_index / l_width;
+      screen_coord_t l_x = l_pixel_index - (l_y * l_width);
+
+      fix32 *l_interpolated_vertex_output = l_span_col + (i * ElementCount);
+      for (auto l_component_it = 0; l_component_it < ElementCount;
+           ++l_component_it) {
+        l_interpolated_vertex_output[l_component_it] =
+            l_planes[l_component_it].at(l_x, l_y);
+      }
+    }
+  };
+
+  void __fragment_span(shader_fragment_batch_function p_fragment_batch,
+                       const uimax *p_span_pixels, uimax p_span_count,
+                       rasterize_heap::worker &p_worker) {
+    for (auto j = 0; j < m_col_count; ++j) {
+      p_worker.m_vertex_output_interpolated_send_to_fragment_shader.at(j) =
+          p_worker.m_span_vertex_output.at(j, 0);
+    }
+
+    p_fragment_batch(
+        p_worker.m_vertex_output_interpolated_send_to_fragment_shader.m_data,
+        p_span_count, (ui8 **)m_fragment_uniforms.data(),
+        p_worker.m_span_colors.m_data);
+
+    color_format::write(m_target_image_view, m_target_format, p_span_pixels,
+                        p_worker.m_span_colors.m_data, p_span_count);
+  };
+
+  void __fragment_span(shader_fragment_function p_fragment,
+                       const uimax *p_span_pixels, uimax p_span_count,
+                       rasterize_heap::worker &p_worker) {
+    rgbf_t l_color_buffer;
+    for (auto i = 0; i < p_span_count; ++i) {
+      for (auto j = 0; j < m_col_count; ++j) {
+        p_worker.m_vertex_output_interpolated_send_to_fragment_shader.at(j) =
+            p_worker.m_span_vertex_output.at(j, i);
+      }
+
+      p_fragment(
+          p_worker.m_vertex_output_interpolated_send_to_fragment_shader.m_data,
+          (ui8 **)m_fragment_uniforms.data(), l_color_buffer);
+
+      p_worker.m_span_colors.at(i) = (l_color_buffer * 255).cast<ui8>();
+    }
+
+    color_format::write(m_target_image_view, m_target_format, p_span_pixels,
+                        p_worker.m_span_colors.m_data, p_span_count);
+  };
 };
 
 struct rasterize_unit {
@@ -260,49 +1227,73 @@ struct rasterize_unit {
     ui32 m_rgba;
 
     image_view m_target_image_view;
+    bgfx::TextureFormat::Enum m_target_format;
     image_view m_target_depth_view;
+    image_view m_target_depth_max_view;
+    target_clear &m_target_clear;
 
     input(const program &p_program, m::rect_point_extend<ui16> &p_rect,
           const m::mat<fix32, 4, 4> &p_proj, const m::mat<fix32, 4, 4> &p_view,
           const m::mat<fix32, 4, 4> &p_transform,
-          const container::range<ui8> &p_index_buffer,
-          bgfx::VertexLayout p_vertex_layout,
+          const container::range<ui8> &p_index_buffer, vindex_t p_min_index,
+          vindex_t p_max_index, bgfx::VertexLayout p_vertex_layout,
           const container::range<ui8> &p_vertex_buffer,
           program_uniforms &p_vertex_uniforms,
           program_uniforms &p_fragment_uniforms, ui64 p_state, ui32 p_rgba,
           const bgfx::TextureInfo &p_target_info,
           container::range<ui8> &p_target_buffer,
           const bgfx::TextureInfo &p_depth_info,
-          container::range<ui8> &p_depth_buffer)
+          container::range<ui8> &p_depth_buffer,
+          const bgfx::TextureInfo &p_depth_max_info,
+          container::range<ui8> &p_depth_max_buffer,
+          target_clear &p_target_clear)
         : m_program(p_program), m_rect(p_rect), m_proj(p_proj), m_view(p_view),
-          m_transform(p_transform), m_index_buffer(p_index_buffer),
+          m_transform(p_transform),
+          m_index_buffer(p_index_buffer, p_min_index, p_max_index),
           m_vertex_layout(p_vertex_layout), m_vertex_buffer(p_vertex_buffer),
           m_vertex_uniforms(p_vertex_uniforms),
           m_fragment_uniforms(p_fragment_uniforms), m_state(p_state),
           m_rgba(p_rgba),
           m_target_image_view(p_target_info.width, p_target_info.height,
                               p_target_info.bitsPerPixel, p_target_buffer),
+          m_target_format(p_target_info.format),
           m_target_depth_view(p_depth_info.width, p_depth_info.height,
-                              p_depth_info.bitsPerPixel, p_depth_buffer){};
+                              p_depth_info.bitsPerPixel, p_depth_buffer),
+          m_target_depth_max_view(p_depth_max_info.width,
+                                  p_depth_max_info.height,
+                                  p_depth_max_info.bitsPerPixel,
+                                  p_depth_max_buffer),
+          m_target_clear(p_target_clear){};
 
   } m_input;
 
   rasterize_heap &m_heap;
+  thread_pool &m_workers;
   render_state m_state;
   m::mat<fix32, 4, 4> m_local_to_unit;
   ui16 m_vertex_stride;
   uimax m_vertex_count;
+  m::vec<fix32, 2> m_guard_band_scale;
 
   uimax m_polygon_count;
 
   m::rect_min_max<ui16> m_rendered_rect;
 
-  rasterize_unit(rasterize_heap &p_heap, const program &p_program,
+  // Deferred draws only write the visibility buffer, see
+  // rasterize_heap::deferred. Polygons of the draw start at m_polygon_begin in
+  // the visibility buffer and their planes at m_plane_begin.
+  ui8 m_deferred;
+  uimax m_polygon_begin;
+  uimax m_plane_begin;
+
+  rasterize_unit(rasterize_heap &p_heap, thread_pool &p_workers,
+                 const program &p_program,
                  m::rect_point_extend<ui16> &p_rect,
                  const m::mat<fix32, 4, 4> &p_proj,
                  const m::mat<fix32, 4, 4> &p_view,
                  const m::mat<fix32, 4, 4> &p_transform,
                  const container::range<ui8> &p_index_buffer,
+                 vindex_t p_min_index, vindex_t p_max_index,
                  bgfx::VertexLayout p_vertex_layout,
                  const container::range<ui8> &p_vertex_buffer,
                  program_uniforms &p_vertex_uniforms,
@@ -310,14 +1301,36 @@ struct rasterize_unit {
                  ui32 p_rgba, const bgfx::TextureInfo &p_target_info,
                  container::range<ui8> &p_target_buffer,
                  const bgfx::TextureInfo &p_depth_info,
-                 container::range<ui8> &p_depth_buffer)
+                 container::range<ui8> &p_depth_buffer,
+                 const bgfx::TextureInfo &p_depth_max_info,
+                 container::range<ui8> &p_depth_max_buffer,
+                 target_clear &p_target_clear)
       : m_input(p_program, p_rect, p_proj, p_view, p_transform, p_index_buffer,
-                p_vertex_layout, p_vertex_buffer, p_vertex_uniforms,
-                p_fragment_uniforms, p_state, p_rgba, p_target_info,
-                p_target_buffer, p_depth_info, p_depth_buffer),
-        m_heap(p_heap){};
+                p_min_index, p_max_index, p_vertex_layout, p_vertex_buffer,
+                p_vertex_uniforms, p_fragment_uniforms, p_state, p_rgba,
+                p_target_info, p_target_buffer, p_depth_info, p_depth_buffer,
+                p_depth_max_info, p_depth_max_buffer, p_target_clear),
+        m_heap(p_heap), m_workers(p_workers){};
 
   void rasterize() {
+    assert_debug(m_heap.m_deferred.m_draws.count() == 0);
+    m_deferred = 0;
+    m_polygon_begin = 0;
+    m_plane_begin = 0;
+    __rasterize();
+  };
+
+  // The draw is shaded by the next resolve_unit of the render pass. The render
+  // state must be opaque.
+  void rasterize_deferred() {
+    m_deferred = 1;
+    m_polygon_begin = m_heap.m_deferred.m_polygon_count;
+    m_plane_begin = m_heap.m_deferred.m_plane_count;
+    __rasterize();
+  };
+
+private:
+  void __rasterize() {
     m_state = render_state::from_int(m_input.m_state);
     m_vertex_stride = m_input.m_vertex_layout.getStride();
     m_vertex_count = m_input.m_vertex_buffer.count() / m_vertex_stride;
@@ -326,6 +1339,7 @@ struct rasterize_unit {
 
     m_polygon_count = m_input.m_index_buffer.m_index_count / 3;
     m_local_to_unit = m_input.m_proj * m_input.m_view * m_input.m_transform;
+    m_guard_band_scale = clip::guard_band_scale(m_input.m_rect.extend());
     block_debug([&]() {
       ui8 l_position_num;
       bgfx::AttribType::Enum l_position_type;
@@ -345,20 +1359,49 @@ struct rasterize_unit {
     __vertex_v2();
 
     __extract_polygons();
+    __setup_polygon_planes();
     __initialize_rendered_rect();
 
-    // TODO -> should apply z clipping
+    __bin_polygons();
 
-    __calculate_visibility_buffer();
-
-    __interpolate_vertex_output();
-    __fragment();
+    // The depth state is resolved once per draw, the visibility loops are
+    // specialized on it.
+    if (m_state.m_depth_write) {
+      __rasterize_tiles<1, 1>();
+    } else if (m_state.m_depth_read) {
+      __rasterize_tiles<1, 0>();
+    } else {
+      __rasterize_tiles<0, 0>();
+    }
 
-    __terminate();
+    if (m_deferred) {
+      __push_deferred_draw();
+    }
   };
 
-private:
-  void __terminate(){};
+  void __push_deferred_draw() {
+    rasterize_heap::deferred &l_deferred = m_heap.m_deferred;
+    const auto &l_layout = m_heap.m_vertex_output_layout;
+
+    rasterize_heap::deferred_draw l_draw;
+    l_draw.m_fragment = m_input.m_program.m_fragment;
+    l_draw.m_fragment_uniforms = m_input.m_fragment_uniforms;
+    l_draw.m_polygon_begin = m_polygon_begin;
+    l_draw.m_polygon_count = m_polygon_count;
+    l_draw.m_plane_begin = m_plane_begin;
+    l_draw.m_layout_begin = l_deferred.m_layouts.count();
+    l_draw.m_col_count = l_layout.m_col_count;
+    l_draw.m_plane_count = l_layout.m_plane_count;
+    l_draw.m_rendered_rect = m_rendered_rect;
+    l_deferred.m_draws.push_back(l_draw);
+
+    for (auto l_col_it = 0; l_col_it < l_layout.m_col_count; ++l_col_it) {
+      l_deferred.m_layouts.push_back(l_layout.m_layout.at(l_col_it));
+    }
+    l_deferred.m_polygon_count += m_polygon_count;
+    l_deferred.m_plane_count += m_polygon_count * l_layout.m_plane_count;
+    m_heap.m_deferred_stats.m_draws += 1;
+  };
 
   void __initialize_layouts() {
 
@@ -369,6 +1412,8 @@ private:
 
     uimax l_vertex_output_col_count = l_output_parameters.count();
     m_heap.m_vertex_output_layout.m_col_count = l_output_parameters.count();
+    m_heap.m_vertex_output_layout.m_plane_count =
+        rasterize_heap::s_depth_plane_index + 1;
 
     for (auto l_col_it = 0;
          l_col_it < m_heap.m_vertex_output_layout.m_col_count; l_col_it++) {
@@ -377,6 +1422,11 @@ private:
       l_layout.m_element_size = l_input_meta.m_single_element_size;
       l_layout.m_attrib_type = l_input_meta.m_attrib_type;
       l_layout.m_attrib_element_count = l_input_meta.m_attrib_element_count;
+      l_layout.m_plane_index = m_heap.m_vertex_output_layout.m_plane_count;
+      if (l_layout.m_attrib_type == bgfx::AttribType::Float) {
+        m_heap.m_vertex_output_layout.m_plane_count +=
+            l_layout.m_attrib_element_count;
+      }
     }
   };
 
@@ -384,38 +1434,36 @@ private:
 
     m_heap.m_vertex_output.resize_col_capacity(
         m_heap.m_vertex_output_layout.m_col_count);
-
-    for (auto l_col_it = 0;
-         l_col_it < m_heap.m_vertex_output_layout.m_col_count; l_col_it++) {
-      m_heap.m_vertex_output.col(l_col_it).resize(
-          m_vertex_count,
-          m_heap.m_vertex_output_layout.m_layout.at(l_col_it).m_element_size);
+    __resize_vertices(m_vertex_count);
+    m_heap.resize_vertex_batch_buffers(
+        m_heap.m_vertex_output_layout.m_layout.m_data,
+        m_heap.m_vertex_output_layout.m_col_count, m_vertex_stride);
+
+    uimax l_visibility_count = m_heap.m_visibility_buffer.count();
+    if (m_input.m_target_image_view.pixel_count() > l_visibility_count) {
+      m_heap.m_visibility_buffer.resize(
+          m_input.m_target_image_view.pixel_count());
+      m_heap.m_visibility_buffer.range().slide(l_visibility_count).zero();
     }
 
-    m_heap.m_per_polygons.resize(m_polygon_count);
-
-    m_heap.m_visibility_buffer.resize(
-        m_input.m_target_image_view.pixel_count());
-    m_heap.m_rasterizationrect_visibility_buffer.resize(
-        m_input.m_target_image_view.pixel_count());
-
-    m_heap.m_vertex_output_interpolated.resize_col_capacity(
-        m_heap.m_vertex_output_layout.m_col_count);
+    if (!m_deferred) {
+      m_heap.resize_shading_buffers(
+          m_heap.m_vertex_output_layout.m_layout.m_data,
+          m_heap.m_vertex_output_layout.m_col_count);
+    }
+  };
 
+  void __resize_vertices(uimax p_vertex_count) {
+    m_heap.m_per_vertices.resize(p_vertex_count);
     for (auto l_col_it = 0;
-         l_col_it < m_heap.m_vertex_output_layout.m_col_count; ++l_col_it) {
-      m_heap.m_vertex_output_interpolated.col(l_col_it).resize(
-          m_input.m_target_image_view.pixel_count(),
+         l_col_it < m_heap.m_vertex_output_layout.m_col_count; l_col_it++) {
+      m_heap.m_vertex_output.col(l_col_it).resize(
+          p_vertex_count,
           m_heap.m_vertex_output_layout.m_layout.at(l_col_it).m_element_size);
     }
-
-    m_heap.m_vertex_output_interpolated_send_to_fragment_shader.resize(
-        m_heap.m_vertex_output_layout.m_col_count);
   };
 
   void __vertex_v2() {
-    m_heap.m_per_vertices.resize(m_vertex_count);
-
     const shader_vertex_runtime_ctx l_ctx = shader_vertex_runtime_ctx(
         m_input.m_proj, m_input.m_view, m_input.m_transform, m_local_to_unit,
         m_input.m_vertex_layout);
@@ -423,49 +1471,241 @@ private:
     assert_debug(m_input.m_program.m_vertex);
     auto l_shader_view =
         rast::shader_vertex_bytes::view{(ui8 *)m_input.m_program.m_vertex};
-    auto l_output_parameters = l_shader_view.output_parameters();
     shader_vertex_function l_vertex_function = l_shader_view.function();
+    shader_vertex_batch_function l_vertex_batch_function =
+        l_shader_view.batch_function();
+
+    frame_stats::vertex_shading l_stats;
+    l_stats.m_vertex_count = m_vertex_count;
+    l_stats.m_index_count = m_input.m_index_buffer.m_index_count;
+    l_stats.m_reused = 0;
+
+    // Only the vertices between the smallest and greatest referenced index
+    // can be used by the draw.
+    const uimax l_referenced_begin = m_input.m_index_buffer.m_min_index;
+    uimax l_referenced_count = 0;
+    if (l_stats.m_index_count > 0) {
+      l_referenced_count =
+          uimax(m_input.m_index_buffer.m_max_index) - l_referenced_begin + 1;
+    }
+    assert_debug(l_referenced_begin + l_referenced_count <= m_vertex_count);
+    l_stats.m_on_demand = l_stats.m_index_count < l_referenced_count;
+
+    if (l_stats.m_on_demand) {
+      auto &l_marks = m_heap.m_vertex_marks;
+      auto &l_indices = m_heap.m_vertex_indices;
+      l_marks.resize(l_referenced_count);
+      l_marks.range().shrink_to(l_referenced_count).zero();
+      l_indices.resize(l_stats.m_index_count);
+
+      l_stats.m_shaded = 0;
+      for (auto i = 0; i < l_stats.m_index_count; ++i) {
+        uimax l_vertex_index = m_input.m_index_buffer.at<vindex_t>(i);
+        ui8 &l_mark = l_marks.at(l_vertex_index - l_referenced_begin);
+        if (l_mark) {
+          l_stats.m_reused += 1;
+        } else {
+          l_mark = 1;
+          l_indices.at(l_stats.m_shaded) = l_vertex_index;
+          l_stats.m_shaded += 1;
+        }
+      }
+    } else {
+      l_stats.m_shaded = l_referenced_count;
+    }
+
+    const uimax l_chunk_size = rasterize_heap::s_vertex_chunk_size;
+    m_workers.dispatch(
+        (l_stats.m_shaded + l_chunk_size - 1) / l_chunk_size,
+        [&](uimax p_task_index, uimax p_worker_index) {
+          rasterize_heap::worker &l_worker =
+              m_heap.m_workers.at(p_worker_index);
+          uimax l_begin = p_task_index * l_chunk_size;
+          uimax l_end = l_begin + l_chunk_size;
+          if (l_end > l_stats.m_shaded) {
+            l_end = l_stats.m_shaded;
+          }
+          if (l_stats.m_on_demand) {
+            const uimax *l_indices = m_heap.m_vertex_indices.m_data;
+            if (l_vertex_batch_function) {
+              __shade_vertex_gathered_batches(l_ctx, l_vertex_batch_function,
+                                              l_indices + l_begin,
+                                              l_indices + l_end, l_worker);
+            } else {
+              for (auto i = l_begin; i < l_end; ++i) {
+                __shade_vertex(l_ctx, l_vertex_function, l_indices[i],
+                               l_worker);
+              }
+            }
+          } else {
+            l_begin += l_referenced_begin;
+            l_end += l_referenced_begin;
+            if (l_vertex_batch_function) {
+              __shade_vertex_batches(l_ctx, l_vertex_batch_function, l_begin,
+                                     l_end, l_worker);
+            } else {
+              for (auto i = l_begin; i < l_end; ++i) {
+                __shade_vertex(l_ctx, l_vertex_function, i, l_worker);
+              }
+            }
+          }
+        });
+
+    m_heap.m_vertex_shading_stats.push_back(l_stats);
+  };
 
-    for (auto i = 0; i < m_vertex_count; ++i) {
-      ui8 *l_vertex_bytes =
-          m_input.m_vertex_buffer.m_begin + (i * m_vertex_stride);
+  void __shade_vertex(const shader_vertex_runtime_ctx &p_ctx,
+                      shader_vertex_function p_vertex_function,
+                      uimax p_vertex_index, rasterize_heap::worker &p_worker) {
+    ui8 *l_vertex_bytes =
+        m_input.m_vertex_buffer.m_begin + (p_vertex_index * m_vertex_stride);
+
+    for (auto l_output_it = 0;
+         l_output_it < m_heap.m_vertex_output_layout.m_col_count;
+         ++l_output_it) {
+      p_worker.m_vertex_output_send_to_vertex_shader.at(l_output_it) =
+          m_heap.m_vertex_output.at(l_output_it, p_vertex_index);
+    }
+
+    m::vec<fix32, 4> l_vertex_shader_out;
+    p_vertex_function(p_ctx, l_vertex_bytes,
+                      (ui8 **)m_input.m_vertex_uniforms.data(),
+                      l_vertex_shader_out,
+                      p_worker.m_vertex_output_send_to_vertex_shader.m_data);
+
+    __set_vertex_position(p_vertex_index, l_vertex_shader_out);
+  };
+
+  // Vertex outputs of a batch are consecutive in the vertex output columns, so
+  // the batch writes them in place.
+  void __shade_vertex_batches(const shader_vertex_runtime_ctx &p_ctx,
+                              shader_vertex_batch_function p_function,
+                              uimax p_begin, uimax p_end,
+                              rasterize_heap::worker &p_worker) {
+    const uimax l_batch_size = shader_vertex_bytes::s_batch_size;
+    fix32 *l_positions[4];
+    for (auto l_component_it = 0; l_component_it < 4; ++l_component_it) {
+      l_positions[l_component_it] =
+          p_worker.m_vertex_batch_positions[l_component_it];
+    }
+
+    for (uimax l_begin = p_begin; l_begin < p_end; l_begin += l_batch_size) {
+      uimax l_count = p_end - l_begin;
+      if (l_count > l_batch_size) {
+        l_count = l_batch_size;
+      }
 
       for (auto l_output_it = 0;
            l_output_it < m_heap.m_vertex_output_layout.m_col_count;
            ++l_output_it) {
-        m_heap.m_vertex_output_send_to_vertex_shader.at(l_output_it) =
-            m_heap.m_vertex_output.at(l_output_it, i);
+        p_worker.m_vertex_output_send_to_vertex_shader.at(l_output_it) =
+            m_heap.m_vertex_output.at(l_output_it, l_begin);
       }
 
-      m::vec<fix32, 4> l_vertex_shader_out;
-      l_vertex_function(l_ctx, l_vertex_bytes,
-                        (ui8 **)m_input.m_vertex_uniforms.data(),
-                        l_vertex_shader_out,
-                        m_heap.m_vertex_output_send_to_vertex_shader.m_data);
+      p_function(p_ctx,
+                 m_input.m_vertex_buffer.m_begin + (l_begin * m_vertex_stride),
+                 l_count, (ui8 **)m_input.m_vertex_uniforms.data(),
+                 l_positions,
+                 p_worker.m_vertex_output_send_to_vertex_shader.m_data);
 
-      l_vertex_shader_out = l_vertex_shader_out / l_vertex_shader_out.w();
+      for (auto i = 0; i < l_count; ++i) {
+        clip_coordinates l_position;
+        for (auto l_component_it = 0; l_component_it < 4; ++l_component_it) {
+          l_position.at(l_component_it) = l_positions[l_component_it][i];
+        }
+        __set_vertex_position(l_begin + i, l_position);
+      }
+    }
+  };
 
-      // [-1, 1] to [0, 1] range
-      l_vertex_shader_out = (l_vertex_shader_out + 1) * 0.5;
+  // Vertices of the on demand shading are scattered in the vertex buffer.
+  // They are gathered in the worker scratch buffers before the batch call and
+  // their outputs are scattered back to the vertex indices.
+  void __shade_vertex_gathered_batches(const shader_vertex_runtime_ctx &p_ctx,
+                                       shader_vertex_batch_function p_function,
+                                       const uimax *p_begin,
+                                       const uimax *p_end,
+                                       rasterize_heap::worker &p_worker) {
+    const uimax l_batch_size = shader_vertex_bytes::s_batch_size;
+    const ui8 l_col_count = m_heap.m_vertex_output_layout.m_col_count;
+    fix32 *l_positions[4];
+    for (auto l_component_it = 0; l_component_it < 4; ++l_component_it) {
+      l_positions[l_component_it] =
+          p_worker.m_vertex_batch_positions[l_component_it];
+    }
+    for (auto l_output_it = 0; l_output_it < l_col_count; ++l_output_it) {
+      p_worker.m_vertex_output_send_to_vertex_shader.at(l_output_it) =
+          p_worker.m_vertex_batch_output.at(l_output_it, 0);
+    }
 
-#if TODO_NEAR_FAR_CLIPPING
-      if (l_vertex_shader_out.z() > 1.0f || l_vertex_shader_out.z() < 0.0f) {
+    for (const uimax *l_batch = p_begin; l_batch < p_end;
+         l_batch += l_batch_size) {
+      uimax l_count = p_end - l_batch;
+      if (l_count > l_batch_size) {
+        l_count = l_batch_size;
       }
-#endif
 
-      uv_t l_pixel_coordinates_fix32 = uv_t::make(l_vertex_shader_out);
-      l_pixel_coordinates_fix32 *= (m_input.m_rect.extend() - 1);
-
-      auto l_pixel_coordinate_i16 = l_pixel_coordinates_fix32.cast<i16>();
-      m_heap.get_pixel_coordinates(i) = l_pixel_coordinate_i16;
+      for (auto i = 0; i < l_count; ++i) {
+        sys::memcpy(p_worker.m_vertex_batch_input.m_data +
+                        (i * m_vertex_stride),
+                    m_input.m_vertex_buffer.m_begin +
+                        (l_batch[i] * m_vertex_stride),
+                    m_vertex_stride);
+      }
 
-      if (m_state.m_depth_read) {
-        m_heap.m_per_vertices.set(
-            i, none(), homogeneous_coordinates::make(l_vertex_shader_out));
+      p_function(p_ctx, p_worker.m_vertex_batch_input.m_data, l_count,
+                 (ui8 **)m_input.m_vertex_uniforms.data(), l_positions,
+                 p_worker.m_vertex_output_send_to_vertex_shader.m_data);
+
+      for (auto i = 0; i < l_count; ++i) {
+        for (auto l_output_it = 0; l_output_it < l_col_count; ++l_output_it) {
+          sys::memcpy(
+              m_heap.m_vertex_output.at(l_output_it, l_batch[i]),
+              p_worker.m_vertex_batch_output.at(l_output_it, i),
+              m_heap.m_vertex_output_layout.m_layout.at(l_output_it)
+                  .m_element_size);
+        }
+        clip_coordinates l_position;
+        for (auto l_component_it = 0; l_component_it < 4; ++l_component_it) {
+          l_position.at(l_component_it) = l_positions[l_component_it][i];
+        }
+        __set_vertex_position(l_batch[i], l_position);
       }
     }
   };
 
+  void __set_vertex_position(uimax p_vertex_index,
+                             const clip_coordinates &p_position) {
+    clip_code_t l_clip_code = clip::code(p_position, m_guard_band_scale);
+    m_heap.m_per_vertices.set(p_vertex_index, none(), none(), p_position,
+                              l_clip_code);
+
+    // Vertices outside of a clip plane only reach the screen through the
+    // vertices created by clipping.
+    if (l_clip_code == 0) {
+      __project_vertex(p_vertex_index, p_position);
+    }
+  };
+
+  void __project_vertex(uimax p_vertex_index, clip_coordinates p_position) {
+    assert_debug(p_position.w() > 0);
+    p_position = p_position / p_position.w();
+
+    // [-1, 1] to [0, 1] range
+    p_position = (p_position + 1) * 0.5;
+
+    uv_t l_pixel_coordinates_fix32 = uv_t::make(p_position);
+    l_pixel_coordinates_fix32 *= (m_input.m_rect.extend() - 1);
+
+    auto l_pixel_coordinate_i16 = l_pixel_coordinates_fix32.cast<i16>();
+    m_heap.get_pixel_coordinates(p_vertex_index) = l_pixel_coordinate_i16;
+
+    if (m_state.m_depth_read) {
+      m_heap.m_per_vertices.set(p_vertex_index, none(),
+                                homogeneous_coordinates::make(p_position));
+    }
+  };
+
   void __extract_polygons() {
 
     switch (m_state.m_cull_mode) {
@@ -481,71 +1721,334 @@ private:
     }
   };
 
+  // Polygons are pushed in submission order, the ones created by clipping a
+  // polygon take its place.
   template <CullMode CullModeValue> void __extract_polygons_internal() {
-    uimax l_index_idx = 0;
-    for (auto i = 0; i < m_polygon_count; ++i) {
-      polygon_vertex_indices *l_polygon_indices;
-      screen_polygon *l_polygon;
-      screen_polygon_bounding_box *l_bounding_rect;
-      screen_polygon_area *l_area;
+    const uimax l_chunk_size = rasterize_heap::s_polygon_chunk_size;
+    uimax l_input_polygon_count = m_polygon_count;
+    uimax l_chunk_count =
+        (l_input_polygon_count + l_chunk_size - 1) / l_chunk_size;
+    m_heap.m_polygon_chunks.resize(l_chunk_count);
+
+    // Polygons that cross a clip plane create vertices, they are counted first
+    // to reserve the vertices of every chunk.
+    m_workers.dispatch(l_chunk_count, [&](uimax p_task_index, uimax) {
+      rasterize_heap::polygon_chunk &l_chunk =
+          m_heap.m_polygon_chunks.at(p_task_index);
+      l_chunk.m_clipped_count = 0;
+      __for_each_chunk_polygon(
+          p_task_index, l_input_polygon_count,
+          [&](const polygon_vertex_indices &, clip_code_t p_crossed_planes) {
+            if (p_crossed_planes) {
+              l_chunk.m_clipped_count += 1;
+            }
+          });
+    });
 
-      m_heap.m_per_polygons.at(i, &l_polygon, &l_polygon_indices,
-                               &l_bounding_rect, &l_area);
-
-      l_polygon_indices->p0() =
-          m_input.m_index_buffer.at<vindex_t>(l_index_idx);
-      l_polygon_indices->p1() =
-          m_input.m_index_buffer.at<vindex_t>(l_index_idx + 1);
-      l_polygon_indices->p2() =
-          m_input.m_index_buffer.at<vindex_t>(l_index_idx + 2);
-
-      l_polygon->p0() = m_heap.get_pixel_coordinates(l_polygon_indices->p0());
-      l_polygon->p1() = m_heap.get_pixel_coordinates(l_polygon_indices->p1());
-      l_polygon->p2() = m_heap.get_pixel_coordinates(l_polygon_indices->p2());
-
-      *l_area = m::cross(
-          (l_polygon->p2() - l_polygon->p0()).cast<screen_polygon_area>(),
-          (l_polygon->p1() - l_polygon->p0()).cast<screen_polygon_area>());
-
-      if constexpr (CullModeValue == CullMode::Clockwise) {
-        if (*l_area >= 0) {
-          i -= 1;
-          m_polygon_count -= 1;
-          goto next;
-        } else {
-          utils::swap_polygon_winding(l_polygon, l_polygon_indices, l_area);
+    uimax l_vertex_count = m_vertex_count;
+    uimax l_polygon_count = 0;
+    for (auto l_chunk_it = 0; l_chunk_it < l_chunk_count; ++l_chunk_it) {
+      rasterize_heap::polygon_chunk &l_chunk =
+          m_heap.m_polygon_chunks.at(l_chunk_it);
+      l_chunk.m_vertex_begin = l_vertex_count;
+      l_chunk.m_vertex_count = 0;
+      l_chunk.m_polygon_begin = l_polygon_count;
+      l_chunk.m_polygon_count = 0;
+      l_vertex_count +=
+          l_chunk.m_clipped_count * clip::s_max_created_vertex_count;
+      l_polygon_count +=
+          __chunk_polygon_count(l_chunk_it, l_input_polygon_count) +
+          (l_chunk.m_clipped_count * (clip::s_max_vertex_count - 3));
+    }
+    if (l_vertex_count > m_heap.m_per_vertices.count()) {
+      __resize_vertices(l_vertex_count);
+    }
+    m_heap.m_per_polygons.resize(l_polygon_count);
+
+    m_workers.dispatch(l_chunk_count, [&](uimax p_task_index, uimax) {
+      rasterize_heap::polygon_chunk &l_chunk =
+          m_heap.m_polygon_chunks.at(p_task_index);
+      __for_each_chunk_polygon(
+          p_task_index, l_input_polygon_count,
+          [&](const polygon_vertex_indices &p_indices,
+              clip_code_t p_crossed_planes) {
+            if (p_crossed_planes) {
+              __clip_polygon<CullModeValue>(p_indices, p_crossed_planes,
+                                            l_chunk);
+            } else {
+              __push_polygon<CullModeValue>(p_indices, l_chunk);
+            }
+          });
+    });
+
+    // Exclusive prefix sum of the chunk polygon counts.
+    m_polygon_count = 0;
+    for (auto l_chunk_it = 0; l_chunk_it < l_chunk_count; ++l_chunk_it) {
+      const rasterize_heap::polygon_chunk &l_chunk =
+          m_heap.m_polygon_chunks.at(l_chunk_it);
+      if (l_chunk.m_polygon_begin != m_polygon_count) {
+        for (auto i = 0; i < l_chunk.m_polygon_count; ++i) {
+          screen_polygon *l_polygon;
+          polygon_vertex_indices *l_indices;
+          screen_polygon_bounding_box *l_bounding_rect;
+          screen_polygon_area *l_area;
+          m_heap.m_per_polygons.at(l_chunk.m_polygon_begin + i, &l_polygon,
+                                   &l_indices, &l_bounding_rect, &l_area);
+          m_heap.m_per_polygons.set(m_polygon_count + i, *l_polygon,
+                                    *l_indices, *l_bounding_rect, *l_area);
         }
-      } else if constexpr (CullModeValue == CullMode::CounterClockwise) {
-        if (*l_area <= 0) {
-          i -= 1;
-          m_polygon_count -= 1;
-          goto next;
+      }
+      m_polygon_count += l_chunk.m_polygon_count;
+    }
+  };
+
+  uimax __chunk_polygon_count(uimax p_chunk_index,
+                              uimax p_input_polygon_count) {
+    uimax l_begin = p_chunk_index * rasterize_heap::s_polygon_chunk_size;
+    uimax l_count = p_input_polygon_count - l_begin;
+    if (l_count > rasterize_heap::s_polygon_chunk_size) {
+      l_count = rasterize_heap::s_polygon_chunk_size;
+    }
+    return l_count;
+  };
+
+  // Calls p_cb with the indices and the crossed clip planes of the triangles
+  // of the chunk that are not entirely outside of a clip plane.
+  template <typename CallbackFunc>
+  void __for_each_chunk_polygon(uimax p_chunk_index,
+                                uimax p_input_polygon_count,
+                                const CallbackFunc &p_cb) {
+    uimax l_begin = p_chunk_index * rasterize_heap::s_polygon_chunk_size;
+    uimax l_end =
+        l_begin + __chunk_polygon_count(p_chunk_index, p_input_polygon_count);
+    for (auto i = l_begin; i < l_end; ++i) {
+      polygon_vertex_indices l_indices;
+      l_indices.p0() = m_input.m_index_buffer.at<vindex_t>(i * 3);
+      l_indices.p1() = m_input.m_index_buffer.at<vindex_t>((i * 3) + 1);
+      l_indices.p2() = m_input.m_index_buffer.at<vindex_t>((i * 3) + 2);
+
+      clip_code_t l_code_0 = m_heap.get_clip_code(l_indices.p0());
+      clip_code_t l_code_1 = m_heap.get_clip_code(l_indices.p1());
+      clip_code_t l_code_2 = m_heap.get_clip_code(l_indices.p2());
+
+      // All vertices are outside of the same plane.
+      if (l_code_0 & l_code_1 & l_code_2) {
+        continue;
+      }
+
+      p_cb(l_indices, clip_code_t(l_code_0 | l_code_1 | l_code_2));
+    }
+  };
+
+  template <CullMode CullModeValue>
+  void __push_polygon(polygon_vertex_indices p_indices,
+                      rasterize_heap::polygon_chunk &p_chunk) {
+    uimax l_polygon_index = p_chunk.m_polygon_begin + p_chunk.m_polygon_count;
+    polygon_vertex_indices *l_polygon_indices;
+    screen_polygon *l_polygon;
+    screen_polygon_bounding_box *l_bounding_rect;
+    screen_polygon_area *l_area;
+
+    m_heap.m_per_polygons.at(l_polygon_index, &l_polygon, &l_polygon_indices,
+                             &l_bounding_rect, &l_area);
+
+    *l_polygon_indices = p_indices;
+    l_polygon->p0() = m_heap.get_pixel_coordinates(l_polygon_indices->p0());
+    l_polygon->p1() = m_heap.get_pixel_coordinates(l_polygon_indices->p1());
+    l_polygon->p2() = m_heap.get_pixel_coordinates(l_polygon_indices->p2());
+
+    *l_area = m::cross(
+        (l_polygon->p2() - l_polygon->p0()).cast<screen_polygon_area>(),
+        (l_polygon->p1() - l_polygon->p0()).cast<screen_polygon_area>());
+
+    if constexpr (CullModeValue == CullMode::Clockwise) {
+      if (*l_area >= 0) {
+        return;
+      } else {
+        utils::swap_polygon_winding(l_polygon, l_polygon_indices, l_area);
+      }
+    } else if constexpr (CullModeValue == CullMode::CounterClockwise) {
+      if (*l_area <= 0) {
+        return;
+      }
+    } else if constexpr (CullModeValue == CullMode::None) {
+      if (*l_area < 0) {
+        utils::swap_polygon_winding(l_polygon, l_polygon_indices, l_area);
+      } else if (*l_area == 0) {
+        return;
+      }
+    }
+
+    *l_bounding_rect = m::bounding_rect(*l_polygon);
+    l_bounding_rect->max() = l_bounding_rect->max() + 1;
+    *l_bounding_rect = m::fit_into(*l_bounding_rect, m_input.m_rect);
+
+    assert_debug(l_bounding_rect->is_valid());
+    assert_debug(l_bounding_rect->max().x() <=
+                 m_input.m_target_image_view.m_width);
+    assert_debug(l_bounding_rect->max().y() <=
+                 m_input.m_target_image_view.m_height);
+
+    // Outside of the viewport.
+    if (l_bounding_rect->min().x() == l_bounding_rect->max().x() ||
+        l_bounding_rect->min().y() == l_bounding_rect->max().y()) {
+      return;
+    }
+
+    p_chunk.m_polygon_count += 1;
+  };
+
+  // Sutherland-Hodgman clipping of the polygon against p_planes. The clipped
+  // polygon is convex, it is pushed as a triangle fan.
+  template <CullMode CullModeValue>
+  void __clip_polygon(const polygon_vertex_indices &p_indices,
+                      clip_code_t p_planes,
+                      rasterize_heap::polygon_chunk &p_chunk) {
+    uimax l_vertices[2][clip::s_max_vertex_count];
+    ui8 l_vertex_count = 3;
+    l_vertices[0][0] = p_indices.p0();
+    l_vertices[0][1] = p_indices.p1();
+    l_vertices[0][2] = p_indices.p2();
+
+    ui8 l_current = 0;
+    for (auto l_plane = 0; l_plane < clip::s_plane_count; ++l_plane) {
+      if (!(p_planes & (1 << l_plane))) {
+        continue;
+      }
+
+      const uimax *l_in = l_vertices[l_current];
+      uimax *l_out = l_vertices[!l_current];
+      ui8 l_out_count = 0;
+
+      for (auto i = 0; i < l_vertex_count; ++i) {
+        uimax l_from = l_in[i];
+        uimax l_to = l_in[(i + 1) % l_vertex_count];
+        clip_distance_t l_from_distance =
+            clip::distance(l_plane, m_heap.get_clip_coordinates(l_from),
+                           m_guard_band_scale);
+        clip_distance_t l_to_distance = clip::distance(
+            l_plane, m_heap.get_clip_coordinates(l_to), m_guard_band_scale);
+
+        ui8 l_from_inside = l_from_distance >= 0;
+        ui8 l_to_inside = l_to_distance >= 0;
+        if (l_from_inside) {
+          l_out[l_out_count] = l_from;
+          l_out_count += 1;
         }
-      } else if constexpr (CullModeValue == CullMode::None) {
-        if (*l_area < 0) {
-          utils::swap_polygon_winding(l_polygon, l_polygon_indices, l_area);
-        } else if (*l_area == 0) {
-          i -= 1;
-          m_polygon_count -= 1;
-          goto next;
+        if (l_from_inside && !l_to_inside) {
+          l_out[l_out_count] = __clip_vertex(l_from, l_to, l_from_distance,
+                                             l_to_distance, p_chunk);
+          l_out_count += 1;
+        } else if (!l_from_inside && l_to_inside) {
+          l_out[l_out_count] = __clip_vertex(l_to, l_from, l_to_distance,
+                                             l_from_distance, p_chunk);
+          l_out_count += 1;
         }
       }
 
-      *l_bounding_rect = m::bounding_rect(*l_polygon);
-      l_bounding_rect->max() = l_bounding_rect->max() + 1;
-      *l_bounding_rect = m::fit_into(*l_bounding_rect, m_input.m_rect);
+      l_current = !l_current;
+      l_vertex_count = l_out_count;
+      if (l_vertex_count < 3) {
+        return;
+      }
+    }
 
-      assert_debug(l_bounding_rect->is_valid());
-      assert_debug(l_bounding_rect->max().x() <=
-                   m_input.m_target_image_view.m_width);
-      assert_debug(l_bounding_rect->max().y() <=
-                   m_input.m_target_image_view.m_height);
+    const uimax *l_clipped = l_vertices[l_current];
+    for (auto i = 1; i < l_vertex_count - 1; ++i) {
+      polygon_vertex_indices l_indices;
+      l_indices.p0() = l_clipped[0];
+      l_indices.p1() = l_clipped[i];
+      l_indices.p2() = l_clipped[i + 1];
+      __push_polygon<CullModeValue>(l_indices, p_chunk);
+    }
+  };
 
-    next:
-      l_index_idx += 3;
+  // Creates the vertex at the intersection of the edge with the plane. Float
+  // vertex outputs are interpolated, the other ones are taken from the inside
+  // vertex.
+  uimax __clip_vertex(uimax p_inside, uimax p_outside,
+                      clip_distance_t p_inside_distance,
+                      clip_distance_t p_outside_distance,
+                      rasterize_heap::polygon_chunk &p_chunk) {
+    uimax l_vertex = p_chunk.m_vertex_begin + p_chunk.m_vertex_count;
+    p_chunk.m_vertex_count += 1;
+
+    const clip_coordinates &l_inside = m_heap.get_clip_coordinates(p_inside);
+    const clip_coordinates &l_outside = m_heap.get_clip_coordinates(p_outside);
+    clip_coordinates l_position;
+    for (auto i = 0; i < 4; ++i) {
+      l_position.at(i) =
+          clip::intersect(l_inside.at(i), l_outside.at(i), p_inside_distance,
+                          p_outside_distance);
+    }
+    m_heap.get_clip_coordinates(l_vertex) = l_position;
+    m_heap.get_clip_code(l_vertex) = 0;
+    __project_vertex(l_vertex, l_position);
+
+    const auto &l_layout = m_heap.m_vertex_output_layout;
+    for (auto l_col_it = 0; l_col_it < l_layout.m_col_count; ++l_col_it) {
+      const auto &l_col = l_layout.m_layout.at(l_col_it);
+      ui8 *l_to = m_heap.m_vertex_output.at(l_col_it, l_vertex);
+      ui8 *l_from_inside = m_heap.m_vertex_output.at(l_col_it, p_inside);
+      if (l_col.m_attrib_type != bgfx::AttribType::Float) {
+        sys::memcpy(l_to, l_from_inside, l_col.m_element_size);
+        continue;
+      }
+      ui8 *l_from_outside = m_heap.m_vertex_output.at(l_col_it, p_outside);
+      for (auto l_component_it = 0;
+           l_component_it < l_col.m_attrib_element_count; ++l_component_it) {
+        ((fix32 *)l_to)[l_component_it] = clip::intersect(
+            ((fix32 *)l_from_inside)[l_component_it],
+            ((fix32 *)l_from_outside)[l_component_it], p_inside_distance,
+            p_outside_distance);
+      }
+    }
+    return l_vertex;
+  };
+
+  void __setup_polygon_planes() {
+    const auto &l_layout = m_heap.m_vertex_output_layout;
+    m_heap.m_polygon_planes.resize(m_plane_begin +
+                                   (m_polygon_count * l_layout.m_plane_count));
+    for (auto l_polygon_it = 0; l_polygon_it < m_polygon_count;
+         ++l_polygon_it) {
+      screen_polygon *l_polygon;
+      polygon_vertex_indices *l_indices;
+      screen_polygon_area *l_area;
+      m_heap.m_per_polygons.at(l_polygon_it, &l_polygon, &l_indices, none(),
+                               &l_area);
+      attribute_plane *l_planes =
+          __polygon_planes(l_polygon_it);
+
+      l_planes[rasterize_heap::s_depth_plane_index] = attribute_plane::make(
+          *l_polygon, *l_area,
+          m_heap.get_vertex_homogenous(l_indices->p0()).z(),
+          m_heap.get_vertex_homogenous(l_indices->p1()).z(),
+          m_heap.get_vertex_homogenous(l_indices->p2()).z());
+
+      for (auto l_col_it = 0; l_col_it < l_layout.m_col_count; ++l_col_it) {
+        const auto &l_col = l_layout.m_layout.at(l_col_it);
+        if (l_col.m_attrib_type != bgfx::AttribType::Float) {
+          continue;
+        }
+        fix32 *l_0 = (fix32 *)m_heap.m_vertex_output.at(l_col_it, l_indices->p0());
+        fix32 *l_1 = (fix32 *)m_heap.m_vertex_output.at(l_col_it, l_indices->p1());
+        fix32 *l_2 = (fix32 *)m_heap.m_vertex_output.at(l_col_it, l_indices->p2());
+        for (auto l_component_it = 0;
+             l_component_it < l_col.m_attrib_element_count; ++l_component_it) {
+          l_planes[l_col.m_plane_index + l_component_it] =
+              attribute_plane::make(*l_polygon, *l_area, l_0[l_component_it],
+                                    l_1[l_component_it], l_2[l_component_it]);
+        }
+      }
     }
   };
 
+  attribute_plane *__polygon_planes(uimax p_polygon_index) {
+    return m_heap.m_polygon_planes.m_data + m_plane_begin +
+           (p_polygon_index * m_heap.m_vertex_output_layout.m_plane_count);
+  };
+
   void __initialize_rendered_rect() {
     if (m_polygon_count == 0) {
       m_rendered_rect.min() = {0, 0};
@@ -568,313 +2071,458 @@ private:
                  m_input.m_target_image_view.m_height);
   };
 
-  void __calculate_visibility_buffer() {
-    container::range<ui8> l_visibility_range;
-    m_heap.m_visibility_buffer.range(&l_visibility_range, none(), none());
-    l_visibility_range =
-        l_visibility_range.shrink_to(m_input.m_target_image_view.pixel_count());
-    l_visibility_range.zero();
+  template <typename CallbackFunc>
+  void __for_each_polygon_tiles(const screen_polygon_bounding_box &p_rect,
+                                const CallbackFunc &p_cb) {
+    if (p_rect.min().x() == p_rect.max().x() ||
+        p_rect.min().y() == p_rect.max().y()) {
+      return;
+    }
+    const auto l_tile_size = rasterize_heap::s_tile_size;
+    for (auto y = p_rect.min().y() / l_tile_size;
+         y <= (p_rect.max().y() - 1) / l_tile_size; ++y) {
+      for (auto x = p_rect.min().x() / l_tile_size;
+           x <= (p_rect.max().x() - 1) / l_tile_size; ++x) {
+        p_cb((y * m_heap.m_tiles.m_count_x) + x);
+      }
+    }
+  };
+
+  // Counting sort of the polygons per tile.
+  void __bin_polygons() {
+    auto &l_tiles = m_heap.m_tiles;
+    const auto l_tile_size = rasterize_heap::s_tile_size;
+    l_tiles.m_count_x =
+        (m_input.m_target_image_view.m_width + l_tile_size - 1) / l_tile_size;
+    l_tiles.m_count_y =
+        (m_input.m_target_image_view.m_height + l_tile_size - 1) / l_tile_size;
+    uimax l_tile_count = l_tiles.m_count_x * l_tiles.m_count_y;
+    assert_debug(l_tiles.m_count_x == m_input.m_target_clear.m_count_x);
+    assert_debug(l_tiles.m_count_y == m_input.m_target_clear.m_count_y);
+
+    l_tiles.m_polygon_offsets.resize(l_tile_count + 1);
+    l_tiles.m_polygon_cursors.resize(l_tile_count);
+    l_tiles.m_rasterized.resize(l_tile_count);
+    l_tiles.m_polygon_offsets.range().shrink_to(l_tile_count + 1).zero();
+
+    container::range<screen_polygon_bounding_box> l_polygon_rects =
+        container::range<screen_polygon_bounding_box>::make(
+            m_heap.m_per_polygons.cols().m_col_2.m_data, m_polygon_count);
 
     for (auto l_polygon_it = 0; l_polygon_it < m_polygon_count;
          ++l_polygon_it) {
-      screen_polygon *l_polygon;
-      polygon_vertex_indices *l_polygon_indices;
-      screen_polygon_bounding_box *l_bounding_rect;
-      screen_polygon_area *l_area;
-      m_heap.m_per_polygons.at(l_polygon_it, &l_polygon, &l_polygon_indices,
-                               &l_bounding_rect, &l_area);
-
-      // Resetting the bouding rect visibility buffer
-      container::range<ui8> l_boudingrect_visibility_range;
-      m_heap.m_rasterizationrect_visibility_buffer.range(
-          &l_boudingrect_visibility_range, none(), none());
-      l_boudingrect_visibility_range = l_boudingrect_visibility_range.shrink_to(
-          m_input.m_target_image_view.pixel_count());
-
-      pixel_coordinates l_rasterization_rect_offset = l_bounding_rect->min();
-      pixel_coordinates l_rasterization_rect_dimensions =
-          (l_bounding_rect->max() - l_bounding_rect->min());
-
-      l_boudingrect_visibility_range = l_boudingrect_visibility_range.shrink_to(
-          l_rasterization_rect_dimensions.x() *
-          l_rasterization_rect_dimensions.y());
-      l_boudingrect_visibility_range.zero();
+      __for_each_polygon_tiles(
+          l_polygon_rects.at(l_polygon_it), [&](uimax p_tile_index) {
+            l_tiles.m_polygon_offsets.at(p_tile_index + 1) += 1;
+          });
+    }
 
-      utils::rasterize_polygon_weighted(
-          *l_polygon, *l_area, *l_bounding_rect,
-          [&](screen_coord_t x, screen_coord_t y, fix32 w0, fix32 w1,
-              fix32 w2) {
-            ui8 *l_visibility_boolean;
-            rasterization_weight *l_visibility_weight;
-            uimax *l_polygon_index;
+    l_tiles.m_rasterized_count = 0;
+    for (auto l_tile_it = 0; l_tile_it < l_tile_count; ++l_tile_it) {
+      if (l_tiles.m_polygon_offsets.at(l_tile_it + 1) > 0) {
+        l_tiles.m_rasterized.at(l_tiles.m_rasterized_count) = l_tile_it;
+        l_tiles.m_rasterized_count += 1;
+      }
+      l_tiles.m_polygon_offsets.at(l_tile_it + 1) +=
+          l_tiles.m_polygon_offsets.at(l_tile_it);
+      l_tiles.m_polygon_cursors.at(l_tile_it) =
+          l_tiles.m_polygon_offsets.at(l_tile_it);
+    }
 
-            pixel_coordinates l_point = {x, y};
-            assert_debug(l_point.x() >= l_bounding_rect->min().x());
-            assert_debug(l_point.y() >= l_bounding_rect->min().y());
-            l_point -= l_bounding_rect->min();
+    l_tiles.m_polygons.resize(l_tiles.m_polygon_offsets.at(l_tile_count));
+    for (auto l_polygon_it = 0; l_polygon_it < m_polygon_count;
+         ++l_polygon_it) {
+      __for_each_polygon_tiles(
+          l_polygon_rects.at(l_polygon_it), [&](uimax p_tile_index) {
+            uimax &l_cursor = l_tiles.m_polygon_cursors.at(p_tile_index);
+            l_tiles.m_polygons.at(l_cursor) = l_polygon_it;
+            l_cursor += 1;
+          });
+    }
+  };
 
-            auto l_boudingrect_visibility_index =
-                (l_point.y() * l_rasterization_rect_dimensions.x()) +
-                l_point.x();
+  template <ui8 DepthRead, ui8 DepthWrite> void __rasterize_tiles() {
+    m_workers.dispatch(m_heap.m_tiles.m_rasterized_count,
+                       [&](uimax p_task_index, uimax p_worker_index) {
+                         __rasterize_tile<DepthRead, DepthWrite>(
+                             m_heap.m_tiles.m_rasterized.at(p_task_index),
+                             m_heap.m_workers.at(p_worker_index));
+                       });
+  };
 
-            assert_debug(l_boudingrect_visibility_index <
-                         l_boudingrect_visibility_range.count());
+  template <ui8 DepthRead, ui8 DepthWrite>
+  void __rasterize_tile(uimax p_tile_index, rasterize_heap::worker &p_worker) {
+    const auto l_tile_size = rasterize_heap::s_tile_size;
+    m::rect_min_max<ui16> l_tile_rect;
+    l_tile_rect.min() = {
+        ui16((p_tile_index % m_heap.m_tiles.m_count_x) * l_tile_size),
+        ui16((p_tile_index / m_heap.m_tiles.m_count_x) * l_tile_size)};
+    l_tile_rect.max() = l_tile_rect.min() + l_tile_size;
+    l_tile_rect = m::fit_into(l_tile_rect, m_rendered_rect);
+
+    container::range<uimax> l_polygons = container::range<uimax>::make(
+        m_heap.m_tiles.m_polygons.m_data +
+            m_heap.m_tiles.m_polygon_offsets.at(p_tile_index),
+        m_heap.m_tiles.m_polygon_offsets.at(p_tile_index + 1) -
+            m_heap.m_tiles.m_polygon_offsets.at(p_tile_index));
+
+    m_input.m_target_clear.materialize_tile(
+        p_tile_index, m_input.m_target_image_view, m_input.m_target_depth_view,
+        m_input.m_target_depth_max_view);
+    __calculate_visibility_buffer<DepthRead, DepthWrite>(l_tile_rect,
+                                                         l_polygons, p_worker);
+    if (!m_deferred) {
+      shading_unit{m_heap,
+                   m_heap.m_vertex_output_layout.m_layout.m_data,
+                   m_heap.m_vertex_output_layout.m_col_count,
+                   m_heap.m_vertex_output_layout.m_plane_count,
+                   __polygon_planes(0),
+                   m_polygon_begin,
+                   m_input.m_program.m_fragment,
+                   m_input.m_fragment_uniforms,
+                   m_input.m_target_image_view,
+                   m_input.m_target_format}
+          .shade(p_worker);
+      m_heap.reset_visibility(p_worker);
+    }
+  };
 
-            m_heap.m_rasterizationrect_visibility_buffer.at(
-                l_boudingrect_visibility_index, &l_visibility_boolean,
-                &l_visibility_weight, &l_polygon_index);
+  template <ui8 DepthRead, ui8 DepthWrite>
+  void __calculate_visibility_buffer(const m::rect_min_max<ui16> &p_tile_rect,
+                                     const container::range<uimax> &p_polygons,
+                                     rasterize_heap::worker &p_worker) {
+    p_worker.m_visible_pixel_count = 0;
 
-            rasterization_weight l_weight = {w0, w1, w2};
+    for (auto l_tile_polygon_it = 0; l_tile_polygon_it < p_polygons.count();
+         ++l_tile_polygon_it) {
+      uimax l_polygon_it = p_polygons.at(l_tile_polygon_it);
+      screen_polygon *l_polygon;
+      polygon_vertex_indices *l_polygon_indices;
+      screen_polygon_bounding_box *l_polygon_bounding_rect;
+      screen_polygon_area *l_area;
+      m_heap.m_per_polygons.at(l_polygon_it, &l_polygon, &l_polygon_indices,
+                               &l_polygon_bounding_rect, &l_area);
 
-            *l_visibility_boolean = 1;
-            *l_visibility_weight = l_weight;
-            *l_polygon_index = l_polygon_it;
-          });
+      screen_polygon_bounding_box l_tile_bounding_rect =
+          m::fit_into(*l_polygon_bounding_rect, p_tile_rect);
+      if (l_tile_bounding_rect.min().x() >= l_tile_bounding_rect.max().x() ||
+          l_tile_bounding_rect.min().y() >= l_tile_bounding_rect.max().y()) {
+        continue;
+      }
 
-      if (m_state.m_depth_read) {
-        m::polygon<fix32, 3> l_attribute_polygon;
+      if constexpr (DepthRead) {
+        m::polygon<fix32, 3> l_depth_polygon;
 
-        l_attribute_polygon.p0() =
+        l_depth_polygon.p0() =
             m_heap.get_vertex_homogenous(l_polygon_indices->p0()).z();
-        l_attribute_polygon.p1() =
+        l_depth_polygon.p1() =
             m_heap.get_vertex_homogenous(l_polygon_indices->p1()).z();
-        l_attribute_polygon.p2() =
+        l_depth_polygon.p2() =
             m_heap.get_vertex_homogenous(l_polygon_indices->p2()).z();
 
-        if (m_state.m_depth_write) {
-          __for_each_bounding_rasterized_pixels_v2(
-              l_rasterization_rect_dimensions, l_bounding_rect->min(),
-              [&](ui8 *l_boundingrect_visibility_boolean,
-                  rasterization_weight *l_boundingrect_visibility_weight,
-                  uimax *l_boundingrect_polygon_index,
-                  uimax l_visibility_index) {
-                visibility_bool_t *l_visibility_boolean;
-                rasterization_weight *l_visibility_weight;
-                visibility_polygon_index_t *l_polygon_index;
-                m_heap.m_visibility_buffer.at(
-                    l_visibility_index, &l_visibility_boolean,
-                    &l_visibility_weight, &l_polygon_index);
-
-                fix32 l_interpolated_depth = m::interpolate(
-                    l_attribute_polygon, *l_boundingrect_visibility_weight);
-                fix32 *l_buffer_depth =
-                    (fix32 *)m_input.m_target_depth_view.at(l_visibility_index);
-
-                if (l_interpolated_depth < *l_buffer_depth) {
-                  *l_visibility_boolean = 1;
-                  *l_visibility_weight = *l_boundingrect_visibility_weight;
-                  *l_polygon_index = *l_boundingrect_polygon_index;
-
-                  // Write to buffer
-                  *l_buffer_depth = l_interpolated_depth;
-                }
-              });
-        } else {
-          __for_each_bounding_rasterized_pixels_v2(
-              l_rasterization_rect_dimensions, l_bounding_rect->min(),
-              [&](ui8 *l_boundingrect_visibility_boolean,
-                  rasterization_weight *l_boundingrect_visibility_weight,
-                  uimax *l_boundingrect_polygon_index,
-                  uimax l_visibility_index) {
-                visibility_bool_t *l_visibility_boolean;
-                rasterization_weight *l_visibility_weight;
-                visibility_polygon_index_t *l_polygon_index;
-                m_heap.m_visibility_buffer.at(
-                    l_visibility_index, &l_visibility_boolean,
-                    &l_visibility_weight, &l_polygon_index);
-
-                fix32 l_interpolated_depth = m::interpolate(
-                    l_attribute_polygon, *l_boundingrect_visibility_weight);
-                fix32 *l_buffer_depth =
-                    (fix32 *)m_input.m_target_depth_view.at(l_visibility_index);
-
-                if (l_interpolated_depth < *l_buffer_depth) {
-                  *l_visibility_boolean = 1;
-                  *l_visibility_weight = *l_boundingrect_visibility_weight;
-                  *l_polygon_index = *l_boundingrect_polygon_index;
-                }
-              });
+        const attribute_plane &l_depth_plane = __polygon_planes(
+            l_polygon_it)[rasterize_heap::s_depth_plane_index];
+        depth_lower_bound l_depth_bound =
+            depth_lower_bound::make(l_depth_polygon, *l_area);
+
+        p_worker.m_depth_max_stats.m_polygon_tested += 1;
+        if (!(l_depth_bound.m_polygon < __depth_max(l_tile_bounding_rect))) {
+          p_worker.m_depth_max_stats.m_polygon_rejected += 1;
+          continue;
         }
-      } else {
-        __for_each_bounding_rasterized_pixels_v2(
-            l_rasterization_rect_dimensions, l_bounding_rect->min(),
-            [&](ui8 *l_boundingrect_visibility_boolean,
-                rasterization_weight *l_boundingrect_visibility_weight,
-                uimax *l_boundingrect_polygon_index, uimax l_visibility_index) {
-              visibility_bool_t *l_visibility_boolean;
-              rasterization_weight *l_visibility_weight;
-              visibility_polygon_index_t *l_polygon_index;
-              m_heap.m_visibility_buffer.at(
-                  l_visibility_index, &l_visibility_boolean,
-                  &l_visibility_weight, &l_polygon_index);
 
-              *l_visibility_boolean = 1;
-              *l_visibility_weight = *l_boundingrect_visibility_weight;
-              *l_polygon_index = *l_boundingrect_polygon_index;
-            });
+        __rasterize_polygon_visibility<DepthRead, DepthWrite>(
+            *l_polygon, *l_area, l_tile_bounding_rect,
+            m_polygon_begin + l_polygon_it, &l_depth_plane, l_depth_bound,
+            p_worker);
+      } else {
+        __rasterize_polygon_visibility<0, 0>(
+            *l_polygon, *l_area, l_tile_bounding_rect,
+            m_polygon_begin + l_polygon_it, 0, depth_lower_bound{}, p_worker);
       }
     }
   };
 
-  template <typename CallbackFunc>
-  void __for_each_bounding_rasterized_pixels_v2(
-      const pixel_coordinates &p_bounding_rect_extend,
-      const pixel_coordinates &p_bounding_rect_offset,
-      const CallbackFunc &p_callback) {
-
-    for (auto y = 0; y < p_bounding_rect_extend.y(); ++y) {
-      for (auto x = 0; x < p_bounding_rect_extend.x(); ++x) {
-        auto l_boudingrect_visibility_index =
-            (y * p_bounding_rect_extend.x()) + x;
-
-        visibility_bool_t *l_boundingrect_visibility_boolean;
-        rasterization_weight *l_boundingrect_visibility_weight;
-        visibility_polygon_index_t *l_boundingrect_polygon_index;
-
-        m_heap.m_rasterizationrect_visibility_buffer.at(
-            l_boudingrect_visibility_index, &l_boundingrect_visibility_boolean,
-            &l_boundingrect_visibility_weight, &l_boundingrect_polygon_index);
-
-        if (*l_boundingrect_visibility_boolean) {
-
-          auto l_visibility_index = ((y + p_bounding_rect_offset.y()) *
-                                     m_input.m_target_image_view.m_width) +
-                                    (x + p_bounding_rect_offset.x());
+  // Lower bound of the depth plane pixels of the polygon. attribute_plane
+  // rounds to nearest with a gradient error far below half a fix32 unit, so a
+  // pixel is never lower than the exact plane minimum by more than m_margin.
+  struct depth_lower_bound {
+    inline static constexpr i32 s_margin = 1;
+
+    m::polygon<fix32, 3> m_depth;
+    screen_polygon_area m_area;
+    fix32 m_polygon;
+
+    static depth_lower_bound make(const m::polygon<fix32, 3> &p_depth,
+                                  screen_polygon_area p_area) {
+      depth_lower_bound l_bound;
+      l_bound.m_depth = p_depth;
+      l_bound.m_area = p_area;
+      i32 l_min = p_depth.p0().m_value;
+      if (p_depth.p1().m_value < l_min) {
+        l_min = p_depth.p1().m_value;
+      }
+      if (p_depth.p2().m_value < l_min) {
+        l_min = p_depth.p2().m_value;
+      }
+      l_bound.m_polygon.m_value = l_min - s_margin;
+      return l_bound;
+    };
 
-          p_callback(l_boundingrect_visibility_boolean,
-                     l_boundingrect_visibility_weight,
-                     l_boundingrect_polygon_index, l_visibility_index);
+    // The depth plane is linear, its minimum over the block is at a corner.
+    fix32 block(const utils::block &p_block) const {
+      i64 l_min = __plane(p_block, 0);
+      for (auto i = 1; i < 4; ++i) {
+        i64 l_corner = __plane(p_block, i);
+        if (l_corner < l_min) {
+          l_min = l_corner;
         }
       }
-    }
-  };
+      fix32 l_block_bound;
+      l_block_bound.m_value = i32(l_min) - s_margin;
+      if (l_block_bound < m_polygon) {
+        return m_polygon;
+      }
+      return l_block_bound;
+    };
 
-  void __interpolate_vertex_output() {
-    __interpolate_vertex_output_range(
-        0, m_heap.m_vertex_output_layout.m_col_count);
+  private:
+    // Rounded towards negative infinity.
+    i64 __plane(const utils::block &p_block, ui8 p_corner) const {
+      i64 l_numerator =
+          (i64(p_block.m_e2[p_corner]) * m_depth.p0().m_value) +
+          (i64(p_block.m_e0[p_corner]) * m_depth.p1().m_value) +
+          (i64(p_block.m_e1[p_corner]) * m_depth.p2().m_value);
+      i64 l_quotient = l_numerator / m_area;
+      if ((l_numerator % m_area) < 0) {
+        l_quotient -= 1;
+      }
+      return l_quotient;
+    };
   };
 
-  void __fragment() {
-    assert_debug(m_input.m_program.m_fragment);
-
-    shader_fragment_function l_fragment =
-        shader_fragment_bytes::view{(ui8 *)m_input.m_program.m_fragment}
-            .fonction();
-
-    rgbf_t l_color_buffer;
-
-    __for_each_rendered_pixels([&](uimax p_pixel_index) {
-      visibility_bool_t *l_visibility_boolean;
-      m_heap.m_visibility_buffer.at(p_pixel_index, &l_visibility_boolean,
-                                    none(), none());
-      if (*l_visibility_boolean) {
-
-        for (auto j = 0; j < m_heap.m_vertex_output_interpolated.m_col_count;
-             ++j) {
-          m_heap.m_vertex_output_interpolated_send_to_fragment_shader.at(j) =
-              m_heap.m_vertex_output_interpolated.at(j, p_pixel_index);
-        }
-
-        l_fragment(
-            m_heap.m_vertex_output_interpolated_send_to_fragment_shader.m_data,
-            (ui8 **)m_input.m_fragment_uniforms.data(), l_color_buffer);
-
-        rgb_t l_color = (l_color_buffer * 255).cast<ui8>();
-        m_input.m_target_image_view.set_pixel(p_pixel_index, l_color);
-      }
-    });
+  fix32 &__depth_max_cell(screen_coord_t p_x, screen_coord_t p_y) {
+    return *(fix32 *)m_input.m_target_depth_max_view.at(
+        p_y / depth_max::s_cell_size, p_x / depth_max::s_cell_size);
   };
 
-  template <typename CallbackFunc>
-  void __for_each_rendered_pixels(const CallbackFunc &p_callback) {
-    for (auto y = m_rendered_rect.min().y(); y < m_rendered_rect.max().y();
-         ++y) {
-      for (auto x = m_rendered_rect.min().x(); x < m_rendered_rect.max().x();
-           ++x) {
-        auto l_pixel_index = (m_input.m_target_image_view.m_width * y) + x;
-        p_callback(l_pixel_index);
-      }
-    }
-  };
-
-  void __interpolate_vertex_output_range(ui8 p_begin_index, ui8 p_end_index) {
-    visibility_bool_t *l_visibility_boolean;
-    rasterization_weight *l_visibility_weight;
-    visibility_polygon_index_t *l_visibility_polygon;
-
-    __for_each_rendered_pixels([&](uimax p_pixel_index) {
-      m_heap.m_visibility_buffer.at(p_pixel_index, &l_visibility_boolean,
-                                    &l_visibility_weight,
-                                    &l_visibility_polygon);
-      if (*l_visibility_boolean) {
-        polygon_vertex_indices *l_indices_polygon;
-        m_heap.m_per_polygons.at(*l_visibility_polygon, none(),
-                                 &l_indices_polygon);
-
-        for (auto l_vertex_output_index = p_begin_index;
-             l_vertex_output_index < p_end_index; ++l_vertex_output_index) {
-          __interpolate_vertex_output_single_value(
-              m_heap.m_vertex_output_layout.m_layout.range(),
-              l_vertex_output_index, *l_indices_polygon, *l_visibility_weight,
-              p_pixel_index);
+  fix32 __depth_max(const screen_polygon_bounding_box &p_rect) {
+    fix32 l_max = __depth_max_cell(p_rect.min().x(), p_rect.min().y());
+    for (auto y = p_rect.min().y(); y < p_rect.max().y();
+         y = ((y / depth_max::s_cell_size) + 1) * depth_max::s_cell_size) {
+      for (auto x = p_rect.min().x(); x < p_rect.max().x();
+           x = ((x / depth_max::s_cell_size) + 1) * depth_max::s_cell_size) {
+        const fix32 &l_cell = __depth_max_cell(x, y);
+        if (l_cell > l_max) {
+          l_max = l_cell;
         }
       }
-    });
+    }
+    return l_max;
   };
 
-  void __interpolate_vertex_output_single_value(
-      const container::range<rasterize_heap::vertex_output_layout::layout>
-          &p_vertex_shader_outputs_meta,
-      uimax p_vertex_output_index,
-      const polygon_vertex_indices &p_indices_polygon,
-      const rasterization_weight &p_polygon_weight, uimax p_pixel_index) {
-
-    const rasterize_heap::vertex_output_layout::layout
-        &l_output_parameter_meta =
-            p_vertex_shader_outputs_meta.at(p_vertex_output_index);
-
-    void *l_0 = m_heap.m_vertex_output.at(p_vertex_output_index,
-                                          p_indices_polygon.p0());
-    void *l_1 = m_heap.m_vertex_output.at(p_vertex_output_index,
-                                          p_indices_polygon.p1());
-    void *l_2 = m_heap.m_vertex_output.at(p_vertex_output_index,
-                                          p_indices_polygon.p2());
-
-    if (l_output_parameter_meta.m_attrib_type == bgfx::AttribType::Float) {
-      if (l_output_parameter_meta.m_attrib_element_count == 3) {
-        m::vec<fix32, 3> *l_interpolated_vertex_output =
-            (m::vec<fix32, 3> *)m_heap.m_vertex_output_interpolated.at(
-                p_vertex_output_index, p_pixel_index);
-
-        *l_interpolated_vertex_output =
-            __interpolate(p_polygon_weight, *(m::vec<fix32, 3> *)l_0,
-                          *(m::vec<fix32, 3> *)l_1, *(m::vec<fix32, 3> *)l_2);
+  // Blocks are the depth max cells. A cell is lowered to the max written
+  // depth only when all of its pixels are written by the polygon, otherwise its
+  // previous value is still an upper bound because depths only decrease.
+  ui8 __is_whole_depth_max_cell(const utils::block &p_block) {
+    screen_coord_t l_cell_width =
+        m_input.m_target_depth_view.m_width - p_block.m_x;
+    if (l_cell_width > depth_max::s_cell_size) {
+      l_cell_width = depth_max::s_cell_size;
+    }
+    screen_coord_t l_cell_height =
+        m_input.m_target_depth_view.m_height - p_block.m_y;
+    if (l_cell_height > depth_max::s_cell_size) {
+      l_cell_height = depth_max::s_cell_size;
+    }
+    return (p_block.m_x % depth_max::s_cell_size) == 0 &&
+           (p_block.m_y % depth_max::s_cell_size) == 0 &&
+           p_block.m_width == l_cell_width && p_block.m_height == l_cell_height;
+  };
 
-      } else if (l_output_parameter_meta.m_attrib_element_count == 1) {
-        fix32 *l_interpolated_vertex_output =
-            (fix32 *)m_heap.m_vertex_output_interpolated.at(
-                p_vertex_output_index, p_pixel_index);
+  // The depth test and the visibility buffer write are done while walking the
+  // polygon edges, covered pixels are written once.
+  template <ui8 DepthRead, ui8 DepthWrite>
+  void __rasterize_polygon_visibility(
+      const screen_polygon &p_polygon, screen_polygon_area p_area,
+      const screen_polygon_bounding_box &p_bounding_rect, uimax p_polygon_index,
+      const attribute_plane *p_depth_plane,
+      const depth_lower_bound &p_depth_bound,
+      rasterize_heap::worker &p_worker) {
+    fix32 l_block_bound;
+    uimax l_block_written_count;
+    fix32 l_block_written_max;
+    const visibility::word_t l_visibility_word =
+        visibility::make(p_polygon_index);
+
+    utils::rasterize_polygon(
+        p_polygon, p_area, p_bounding_rect,
+        [&](const utils::block &p_block, const auto &p_rasterize) {
+          if constexpr (DepthRead) {
+            fix32 &l_cell = __depth_max_cell(p_block.m_x, p_block.m_y);
+            p_worker.m_depth_max_stats.m_block_tested += 1;
+            l_block_bound = p_depth_bound.block(p_block);
+            if (!(l_block_bound < l_cell)) {
+              p_worker.m_depth_max_stats.m_block_rejected += 1;
+              return;
+            }
+
+            l_block_written_count = 0;
+            l_block_written_max = p_depth_bound.m_polygon;
+            p_rasterize();
+
+            if constexpr (DepthWrite) {
+              if (l_block_written_count ==
+                      uimax(p_block.m_width * p_block.m_height) &&
+                  __is_whole_depth_max_cell(p_block)) {
+                l_cell = l_block_written_max;
+              }
+            }
+          } else {
+            p_rasterize();
+          }
+        },
+        [&](screen_coord_t x, screen_coord_t y) {
+          assert_debug(x >= p_bounding_rect.min().x() &&
+                       x < p_bounding_rect.max().x());
+          assert_debug(y >= p_bounding_rect.min().y() &&
+                       y < p_bounding_rect.max().y());
+          uimax l_visibility_index =
+              (y * m_input.m_target_image_view.m_width) + x;
+
+          if constexpr (DepthRead) {
+            fix32 l_interpolated_depth = p_depth_plane->at(x, y);
+            assert_debug(l_interpolated_depth >= l_block_bound);
+            fix32 *l_buffer_depth =
+                (fix32 *)m_input.m_target_depth_view.at(l_visibility_index);
+            if (!(l_interpolated_depth < *l_buffer_depth)) {
+              return;
+            }
+            if constexpr (DepthWrite) {
+              *l_buffer_depth = l_interpolated_depth;
+              l_block_written_count += 1;
+              if (l_interpolated_depth > l_block_written_max) {
+                l_block_written_max = l_interpolated_depth;
+              }
+            }
+          }
+
+          visibility::word_t &l_visibility =
+              m_heap.m_visibility_buffer.at(l_visibility_index);
+          if (!visibility::is_visible(l_visibility)) {
+            p_worker.m_visible_pixels.at(p_worker.m_visible_pixel_count) =
+                l_visibility_index;
+            p_worker.m_visible_pixel_count += 1;
+          }
+          l_visibility = l_visibility_word;
+        });
+  };
+};
 
-        *l_interpolated_vertex_output = __interpolate(
-            p_polygon_weight, *(fix32 *)l_0, *(fix32 *)l_1, *(fix32 *)l_2);
-      };
+// Interpolation and fragment shading of the deferred draws of a render pass.
+// Every visible pixel is shaded once, by the draw that owns the last polygon
+// written to it.
+struct resolve_unit {
+  rasterize_heap &m_heap;
+  thread_pool &m_workers;
+  image_view m_target_image_view;
+  bgfx::TextureFormat::Enum m_target_format;
+
+  resolve_unit(rasterize_heap &p_heap, thread_pool &p_workers,
+               const bgfx::TextureInfo &p_target_info,
+               container::range<ui8> &p_target_buffer)
+      : m_heap(p_heap), m_workers(p_workers),
+        m_target_image_view(p_target_info.width, p_target_info.height,
+                            p_target_info.bitsPerPixel, p_target_buffer),
+        m_target_format(p_target_info.format){};
+
+  void resolve() {
+    rasterize_heap::deferred &l_deferred = m_heap.m_deferred;
+    for (auto l_draw_it = 0; l_draw_it < l_deferred.m_draws.count();
+         ++l_draw_it) {
+      __resolve_draw(l_deferred.m_draws.at(l_draw_it));
     }
+    l_deferred.clear();
   };
 
-  template <typename T>
-  T __interpolate(const rasterization_weight &p_weights, const T &p_0,
-                  const T &p_1, const T &p_2) {
-    m::polygon<T, 3> l_attribute_polygon;
+private:
+  void __resolve_draw(const rasterize_heap::deferred_draw &p_draw) {
+    const m::rect_min_max<ui16> &l_rect = p_draw.m_rendered_rect;
+    if (l_rect.min().x() == l_rect.max().x() ||
+        l_rect.min().y() == l_rect.max().y()) {
+      return;
+    }
 
-    l_attribute_polygon.p0() = p_0;
-    l_attribute_polygon.p1() = p_1;
-    l_attribute_polygon.p2() = p_2;
+    const rasterize_heap::vertex_output_layout::layout *l_layouts =
+        m_heap.m_deferred.m_layouts.m_data + p_draw.m_layout_begin;
+    m_heap.resize_shading_buffers(l_layouts, p_draw.m_col_count);
+
+    shading_unit l_shading_unit = {
+        m_heap,
+        l_layouts,
+        p_draw.m_col_count,
+        p_draw.m_plane_count,
+        m_heap.m_polygon_planes.m_data + p_draw.m_plane_begin,
+        p_draw.m_polygon_begin,
+        p_draw.m_fragment,
+        p_draw.m_fragment_uniforms,
+        m_target_image_view,
+        m_target_format};
+
+    const auto l_tile_size = rasterize_heap::s_tile_size;
+    const ui16 l_tile_min_x = l_rect.min().x() / l_tile_size;
+    const ui16 l_tile_min_y = l_rect.min().y() / l_tile_size;
+    const ui16 l_tile_count_x =
+        ((l_rect.max().x() - 1) / l_tile_size) - l_tile_min_x + 1;
+    const ui16 l_tile_count_y =
+        ((l_rect.max().y() - 1) / l_tile_size) - l_tile_min_y + 1;
+
+    m_workers.dispatch(
+        l_tile_count_x * l_tile_count_y,
+        [&](uimax p_task_index, uimax p_worker_index) {
+          m::rect_min_max<ui16> l_tile_rect;
+          l_tile_rect.min() = {
+              ui16((l_tile_min_x + (p_task_index % l_tile_count_x)) *
+                   l_tile_size),
+              ui16((l_tile_min_y + (p_task_index / l_tile_count_x)) *
+                   l_tile_size)};
+          l_tile_rect.max() = l_tile_rect.min() + l_tile_size;
+          l_tile_rect = m::fit_into(l_tile_rect, l_rect);
+
+          rasterize_heap::worker &l_worker =
+              m_heap.m_workers.at(p_worker_index);
+          __gather_visible_pixels(p_draw, l_tile_rect, l_worker);
+          l_shading_unit.shade(l_worker);
+          m_heap.reset_visibility(l_worker);
+          l_worker.m_deferred_shaded += l_worker.m_visible_pixel_count;
+        });
+  };
 
-    return m::interpolate(l_attribute_polygon, p_weights);
+  void __gather_visible_pixels(const rasterize_heap::deferred_draw &p_draw,
+                               const m::rect_min_max<ui16> &p_tile_rect,
+                               rasterize_heap::worker &p_worker) {
+    p_worker.m_visible_pixel_count = 0;
+    for (auto y = p_tile_rect.min().y(); y < p_tile_rect.max().y(); ++y) {
+      for (auto x = p_tile_rect.min().x(); x < p_tile_rect.max().x(); ++x) {
+        uimax l_pixel_index = (y * m_target_image_view.m_width) + x;
+        visibility::word_t l_visibility =
+            m_heap.m_visibility_buffer.at(l_pixel_index);
+        if (!visibility::is_visible(l_visibility)) {
+          continue;
+        }
+        uimax l_polygon_index = visibility::polygon_index(l_visibility);
+        if (l_polygon_index >= p_draw.m_polygon_begin &&
+            l_polygon_index < p_draw.m_polygon_begin + p_draw.m_polygon_count) {
+          p_worker.m_visible_pixels.at(p_worker.m_visible_pixel_count) =
+              l_pixel_index;
+          p_worker.m_visible_pixel_count += 1;
+        }
+      }
+    }
   };
 };
 
 } // namespace algorithm
 } // namespace rast
 
-#undef TODO_NEAR_FAR_CLIPPING
\ No newline at end of file
+#undef RAST_EDGE_KERNEL_SSE2
\ No newline at end of file
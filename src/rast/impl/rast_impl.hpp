@@ -25,6 +25,10 @@ struct rast_impl_software {
   struct framebuffer {
     bgfx::TextureHandle m_rgb;
     bgfx::TextureHandle m_depth;
+    // Coarse max depth of m_depth, allocated with it.
+    bgfx::TextureHandle m_depth_max;
+    // Clears are applied lazily per tile, see algorithm::target_clear.
+    rast::algorithm::target_clear m_clear;
 
     ui8 has_depth() const { return m_depth.idx != bgfx::kInvalidHandle; };
   };
@@ -32,6 +36,9 @@ struct rast_impl_software {
   struct vertexbuffer {
     bgfx::VertexLayout layout;
     const bgfx::Memory *memory;
+    // Draws of a bounded vertex buffer are culled against the view frustum.
+    ui8 has_bounds;
+    bounding_volume bounds;
 
     container::range<ui8> range() {
       return container::range<ui8>::make(memory->data, memory->size);
@@ -40,6 +47,10 @@ struct rast_impl_software {
 
   struct indexbuffer {
     const bgfx::Memory *memory;
+    // Smallest and greatest vertex index referenced by the buffer, gathered
+    // once when the buffer is created.
+    vindex_t min_index;
+    vindex_t max_index;
 
     container::range<ui8> range() {
       return container::range<ui8>::make(memory->data, memory->size);
@@ -126,12 +137,20 @@ struct rast_impl_software {
     m::vec<ui16, 4> m_scissor;
     m::mat<fix32, 4, 4> m_view;
     m::mat<fix32, 4, 4> m_proj;
+    // Opaque draws are shaded once per pixel at the end of the pass, see
+    // rast::algorithm::resolve_unit.
+    ui8 m_deferred;
 
     container::vector<command_draw_call> m_commands;
 
     void allocate() { m_commands.allocate(0); };
     void free() { m_commands.free(); };
 
+    // Nothing is rendered by a pass without draws nor clears.
+    ui8 is_empty() const {
+      return m_commands.count() == 0 && m_clear.m_flags.m_int == 0;
+    };
+
     static render_pass get_default() {
       render_pass l_render_pass;
       l_render_pass.allocate();
@@ -140,6 +159,7 @@ struct rast_impl_software {
       l_render_pass.m_scissor = l_render_pass.m_scissor.getZero();
       l_render_pass.m_view = l_render_pass.m_view.getZero();
       l_render_pass.m_proj = l_render_pass.m_proj.getZero();
+      l_render_pass.m_deferred = 0;
       l_render_pass.m_clear.reset();
       return l_render_pass;
     };
@@ -216,7 +236,7 @@ struct rast_impl_software {
       assert_debug(!m_uniform_command_stack.has_allocated_elements());
       assert_debug(!m_vertexbuffer_table.has_allocated_elements());
       assert_debug(!m_indexbuffer_table.has_allocated_elements());
-      assert_debug(m_renderpass_table.count() == 1);
+      assert_debug(m_renderpass_table.count() >= 1);
       assert_debug(!m_shader_table.has_allocated_elements());
       assert_debug(!m_program_table.has_allocated_elements());
       assert_debug(!m_framebuffer_table.has_allocated_elements());
@@ -326,13 +346,19 @@ struct rast_impl_software {
       }
     };
 
+    // The texture content is p_memory when it is not null.
     bgfx::TextureHandle
-    allocate_texture(const bgfx::TextureInfo &p_texture_info) {
+    allocate_texture(const bgfx::TextureInfo &p_texture_info,
+                     const void *p_memory = 0) {
       uimax l_image_size = uimax(p_texture_info.bitsPerPixel *
                                  p_texture_info.width * p_texture_info.height);
       texture l_texture;
       l_texture.m_info = p_texture_info;
-      l_texture.m_buffer = allocate_buffer(l_image_size);
+      if (p_memory) {
+        l_texture.m_buffer = allocate_ref(p_memory, l_image_size);
+      } else {
+        l_texture.m_buffer = allocate_buffer(l_image_size);
+      }
       bgfx::TextureHandle l_texture_handle;
       l_texture_handle.idx = m_texture_table.push_back(l_texture);
 
@@ -348,10 +374,17 @@ struct rast_impl_software {
 
     bgfx::FrameBufferHandle
     allocate_frame_buffer(bgfx::TextureHandle p_rgb_texture,
-                          bgfx::TextureHandle p_depth_texture) {
+                          bgfx::TextureHandle p_depth_texture,
+                          bgfx::TextureHandle p_depth_max_texture) {
       framebuffer l_frame_buffer;
       l_frame_buffer.m_rgb = p_rgb_texture;
       l_frame_buffer.m_depth = p_depth_texture;
+      l_frame_buffer.m_depth_max = p_depth_max_texture;
+      texture *l_rgb_texture;
+      m_texture_table.at(p_rgb_texture.idx, &l_rgb_texture);
+      l_frame_buffer.m_clear.allocate(l_rgb_texture->m_info.width,
+                                      l_rgb_texture->m_info.height,
+                                      l_rgb_texture->m_info.format);
 
       bgfx::FrameBufferHandle l_handle;
       l_handle.idx = m_framebuffer_table.push_back(l_frame_buffer);
@@ -364,13 +397,42 @@ struct rast_impl_software {
       return l_frame_buffer;
     };
 
+    // The frame buffer that renders to p_texture, null if there is none.
+    framebuffer *find_frame_buffer(bgfx::TextureHandle p_texture) {
+      for (auto i = 0; i < m_framebuffer_table.m_meta.m_count; ++i) {
+        if (!m_framebuffer_table.m_meta.is_element_allocated(i)) {
+          continue;
+        }
+        framebuffer *l_frame_buffer;
+        m_framebuffer_table.at(i, &l_frame_buffer);
+        if (l_frame_buffer->m_rgb.idx == p_texture.idx ||
+            (l_frame_buffer->has_depth() &&
+             l_frame_buffer->m_depth.idx == p_texture.idx)) {
+          return l_frame_buffer;
+        }
+      }
+      return 0;
+    };
+
     void free_frame_buffer(bgfx::FrameBufferHandle p_frame_buffer) {
       framebuffer *l_frame_buffer = get_frame_buffer(p_frame_buffer);
+      l_frame_buffer->m_clear.free();
       free_texture(l_frame_buffer->m_rgb);
       if (l_frame_buffer->has_depth()) {
         free_texture(l_frame_buffer->m_depth);
+        free_texture(l_frame_buffer->m_depth_max);
       }
       m_framebuffer_table.remove_at(p_frame_buffer.idx);
+
+      // Views of the frame buffer are left empty.
+      for (auto i = 0; i < m_renderpass_table.count(); ++i) {
+        render_pass *l_render_pass;
+        m_renderpass_table.at(i, &l_render_pass);
+        if (l_render_pass->m_framebuffer.idx == p_frame_buffer.idx) {
+          l_render_pass->m_framebuffer.idx = bgfx::kInvalidHandle;
+          l_render_pass->m_clear.reset();
+        }
+      }
     };
 
     bgfx::VertexBufferHandle
@@ -383,6 +445,7 @@ struct rast_impl_software {
       vertexbuffer l_vertex_buffer;
       l_vertex_buffer.layout = p_layout;
       l_vertex_buffer.memory = p_memory;
+      l_vertex_buffer.has_bounds = 0;
       bgfx::VertexBufferHandle l_handle;
       l_handle.idx = m_vertexbuffer_table.push_back(l_vertex_buffer);
       return l_handle;
@@ -399,6 +462,22 @@ struct rast_impl_software {
     allocate_index_buffer(const bgfx::Memory *p_memory) {
       indexbuffer l_index_buffer;
       l_index_buffer.memory = p_memory;
+      l_index_buffer.min_index = 0;
+      l_index_buffer.max_index = 0;
+      auto l_indices = l_index_buffer.range().cast_to<vindex_t>();
+      if (l_indices.count() > 0) {
+        l_index_buffer.min_index = l_indices.at(0);
+        l_index_buffer.max_index = l_indices.at(0);
+        for (auto i = 1; i < l_indices.count(); ++i) {
+          vindex_t l_index = l_indices.at(i);
+          if (l_index < l_index_buffer.min_index) {
+            l_index_buffer.min_index = l_index;
+          }
+          if (l_index > l_index_buffer.max_index) {
+            l_index_buffer.max_index = l_index;
+          }
+        }
+      }
       bgfx::IndexBufferHandle l_handle;
       l_handle.idx = m_indexbuffer_table.push_back(l_index_buffer);
       return l_handle;
@@ -473,7 +552,17 @@ struct rast_impl_software {
 
   } heap;
 
-  rast::algorithm::rasterize_heap m_rasterize_heap;
+  // One heap per pass of the largest group of render passes rendered
+  // concurrently.
+  container::vector<rast::algorithm::rasterize_heap> m_rasterize_heaps;
+  thread_pool m_rasterize_workers;
+  // m_rasterize_pass_workers.at(n - 1) splits the rasterize workers between the
+  // n passes of a group. Allocated the first time a group of n passes is
+  // rendered.
+  container::vector<container::span<thread_pool>> m_rasterize_pass_workers;
+  // Indices of the render passes that are not empty, in view order.
+  container::vector<uimax> m_frame_render_passes;
+  rast::frame_stats m_stats;
 
   struct texture_proxy {
     struct heap &m_heap;
@@ -497,6 +586,12 @@ struct rast_impl_software {
       m_heap.m_texture_table.at(m_value->m_depth.idx, &l_texture);
       return {.m_heap = m_heap, .m_value = l_texture};
     };
+
+    texture_proxy DepthMaxTexture() {
+      texture *l_texture;
+      m_heap.m_texture_table.at(m_value->m_depth_max.idx, &l_texture);
+      return {.m_heap = m_heap, .m_value = l_texture};
+    };
   };
 
   struct renderpass_proxy {
@@ -590,7 +685,11 @@ struct rast_impl_software {
       return {.m_heap = m_heap, .m_value = l_frame_buffer};
     };
 
+    // Views are created with the default state by their first use.
     renderpass_proxy RenderPass(bgfx::ViewId p_handle) {
+      while (m_heap.m_renderpass_table.count() <= p_handle) {
+        m_heap.m_renderpass_table.push_back(render_pass::get_default());
+      }
       struct render_pass *l_render_pass;
       m_heap.m_renderpass_table.at(p_handle, &l_render_pass);
       return renderpass_proxy(m_heap, l_render_pass);
@@ -626,17 +725,19 @@ struct rast_impl_software {
   bgfx::TextureHandle allocate_texture(uint16_t p_width, uint16_t p_height,
                                        bool p_hasMips, uint16_t p_numLayers,
                                        bgfx::TextureFormat::Enum p_format,
-                                       uint64_t p_flags) {
+                                       uint64_t p_flags,
+                                       const void *p_memory = 0) {
     bgfx::TextureInfo l_texture_info{};
     l_texture_info.format = p_format;
     l_texture_info.width = p_width;
     l_texture_info.height = p_height;
     l_texture_info.bitsPerPixel = textureformat_to_pixel_size(p_format);
     assert_debug(l_texture_info.bitsPerPixel != 0);
-    return heap.allocate_texture(l_texture_info);
+    return heap.allocate_texture(l_texture_info, p_memory);
   };
 
   void read_texture(bgfx::TextureHandle p_texture, ui8 *out) {
+    materialize_clears(p_texture);
     container::range<ui8> l_texture_range =
         proxy().Texture(p_texture).value()->range();
     container::range<ui8> l_target_range =
@@ -651,24 +752,89 @@ struct rast_impl_software {
     auto l_texture =
         allocate_texture(p_width, p_height, 0, 0, p_rgb_format, p_textureFlags);
     return heap.allocate_frame_buffer(
-        l_texture, bgfx::TextureHandle{bgfx::kInvalidHandle});
+        l_texture, bgfx::TextureHandle{bgfx::kInvalidHandle},
+        bgfx::TextureHandle{bgfx::kInvalidHandle});
   };
 
   bgfx::FrameBufferHandle
   allocate_frame_buffer(uint16_t p_width, uint16_t p_height,
                         bgfx::TextureFormat::Enum p_rgb_format,
-                        bgfx::TextureFormat::Enum p_depth_format) {
-    auto l_rgb_texture =
-        allocate_texture(p_width, p_height, 0, 0, p_rgb_format, 0);
+                        bgfx::TextureFormat::Enum p_depth_format,
+                        const void *p_rgb_memory = 0) {
+    auto l_rgb_texture = allocate_texture(p_width, p_height, 0, 0, p_rgb_format,
+                                          0, p_rgb_memory);
     auto l_depth_format =
         allocate_texture(p_width, p_height, 0, 0, p_depth_format, 0);
-    return heap.allocate_frame_buffer(l_rgb_texture, l_depth_format);
+
+    // The depth content is undefined until the first depth clear, so cells
+    // start at the highest depth and nothing is rejected before that.
+    auto l_depth_max = allocate_texture(
+        rast::algorithm::depth_max::cell_count(p_width),
+        rast::algorithm::depth_max::cell_count(p_height), 0, 0, p_depth_format,
+        0);
+    fix32 l_highest_depth;
+    l_highest_depth.m_value = i32(0x7FFFFFFF);
+    __texture_view(proxy().Texture(l_depth_max))
+        .for_each<fix32>([&](fix32 &p_cell) { p_cell = l_highest_depth; });
+
+    return heap.allocate_frame_buffer(l_rgb_texture, l_depth_format,
+                                      l_depth_max);
+  };
+
+  // Pending clears of the frame buffer that renders to p_texture are applied so
+  // that the texture content can be read.
+  void materialize_clears(bgfx::TextureHandle p_texture) {
+    framebuffer *l_frame_buffer = heap.find_frame_buffer(p_texture);
+    if (!l_frame_buffer || !l_frame_buffer->m_clear.m_has_pending) {
+      return;
+    }
+    rast::image_view l_rgb_view =
+        __texture_view(proxy().Texture(l_frame_buffer->m_rgb));
+    if (l_frame_buffer->has_depth()) {
+      rast::image_view l_depth_view =
+          __texture_view(proxy().Texture(l_frame_buffer->m_depth));
+      rast::image_view l_depth_max_view =
+          __texture_view(proxy().Texture(l_frame_buffer->m_depth_max));
+      l_frame_buffer->m_clear.materialize_all(l_rgb_view, l_depth_view,
+                                              l_depth_max_view);
+    } else {
+      rast::image_view l_empty_view(0, 0, 0,
+                                    container::range<ui8>::make(0, 0));
+      l_frame_buffer->m_clear.materialize_all(l_rgb_view, l_empty_view,
+                                              l_empty_view);
+    }
   };
 
   bgfx::TextureHandle get_texture(bgfx::FrameBufferHandle p_frame_buffer) {
     return proxy().FrameBuffer(p_frame_buffer).m_value->m_rgb;
   };
 
+  // Only textures referencing external memory can be moved, their content is
+  // owned by the caller. Pending clears are applied to the new memory.
+  uintptr_t override_texture_memory(bgfx::TextureHandle p_texture,
+                                    ui8 *p_memory) {
+    texture *l_texture;
+    heap.m_texture_table.at(p_texture.idx, &l_texture);
+    block_debug([&]() {
+      for (auto i = 0; i < heap.m_buffers_ptr_mapping_table.m_meta.m_count;
+           ++i) {
+        bgfx::Memory **l_buffer;
+        heap.m_buffers_ptr_mapping_table.at(i, &l_buffer, none());
+        if (*l_buffer == l_texture->m_buffer) {
+          uimax *l_buffer_index;
+          heap.m_buffers_ptr_mapping_table.at(i, none(), &l_buffer_index);
+          memory_reference *l_reference;
+          heap.m_buffer_reference_table.at(*l_buffer_index, none(),
+                                           &l_reference);
+          assert_debug(l_reference->is_ref());
+        }
+      }
+    });
+    ui8 *l_previous = l_texture->m_buffer->data;
+    l_texture->m_buffer->data = p_memory;
+    return uintptr_t(l_previous);
+  };
+
   bgfx::ProgramHandle allocate_program(bgfx::ShaderHandle p_vertex,
                                        bgfx::ShaderHandle p_fragment) {
     program l_program;
@@ -698,6 +864,18 @@ struct rast_impl_software {
     l_clear.m_depth = p_depth;
   };
 
+  void view_set_deferred(bgfx::ViewId p_id, ui8 p_deferred) {
+    proxy().RenderPass(p_id).value()->m_deferred = p_deferred;
+  };
+
+  void vertex_buffer_set_bounds(bgfx::VertexBufferHandle p_handle,
+                                const bounding_volume &p_bounds) {
+    vertexbuffer *l_vertex_buffer;
+    heap.m_vertexbuffer_table.at(p_handle.idx, &l_vertex_buffer);
+    l_vertex_buffer->has_bounds = 1;
+    l_vertex_buffer->bounds = p_bounds;
+  };
+
   void view_set_transform(bgfx::ViewId p_id, const m::mat<fix32, 4, 4> &p_view,
                           const m::mat<fix32, 4, 4> &p_proj) {
     renderpass_proxy l_render_pass = proxy().RenderPass(p_id);
@@ -753,83 +931,29 @@ struct rast_impl_software {
   };
 
   void frame() {
+    m_stats.reset();
 
-    proxy().for_each_renderpass([&](renderpass_proxy &p_render_pass) {
-      framebuffer_proxy l_frame_buffer = p_render_pass.FrameBuffer();
-      texture_proxy l_frame_rgb_texture = l_frame_buffer.RGBTexture();
-      container::range<ui8> l_frame_rgb_texture_range =
-          l_frame_rgb_texture.value()->range();
-
-      container::range<ui8> l_frame_depth_texture_range;
-      bgfx::TextureInfo l_frame_depth_texture_info;
-
-      if (l_frame_buffer.m_value->has_depth()) {
-        texture_proxy l_frame_depth_texture =
-            p_render_pass.FrameBuffer().DepthTexture();
-        l_frame_depth_texture_range = l_frame_depth_texture.value()->range();
-        l_frame_depth_texture_info = l_frame_depth_texture.value()->m_info;
-      } else {
-        l_frame_depth_texture_range = container::range<ui8>::make(0, 0);
-        l_frame_depth_texture_info.bitsPerPixel = 0;
+    m_frame_render_passes.clear();
+    for (auto i = 0; i < heap.m_renderpass_table.count(); ++i) {
+      if (!proxy().RenderPass(i).value()->is_empty()) {
+        m_frame_render_passes.push_back(i);
       }
+    }
 
-      // color clear
-      {
-        const clear_state &l_clear_state = p_render_pass.value()->m_clear;
-        if (l_clear_state.m_flags.m_color) {
-          texture *l_texture = l_frame_rgb_texture.value();
-          rast::image_view l_target_view(
-              l_texture->m_info.width, l_texture->m_info.height,
-              l_texture->m_info.bitsPerPixel, l_frame_rgb_texture_range);
-          l_target_view.for_each<rgb_t>([&](rgb_t &p_pixel) {
-            p_pixel.x() = l_clear_state.m_rgba.r;
-            p_pixel.y() = l_clear_state.m_rgba.g;
-            p_pixel.z() = l_clear_state.m_rgba.b;
-          });
-        }
-
-        if (l_clear_state.m_flags.m_depth) {
-          assert_debug(l_frame_buffer.m_value->has_depth());
-          rast::image_view l_depth_view(l_frame_depth_texture_info.width,
-                                        l_frame_depth_texture_info.height,
-                                        l_frame_depth_texture_info.bitsPerPixel,
-                                        l_frame_depth_texture_range);
-          l_depth_view.for_each<fix32>(
-              [&](fix32 &p_pixel) { p_pixel = l_clear_state.m_depth; });
-        }
+    // Consecutive render passes that don't share a texture form a group that
+    // is rendered concurrently, one pass per task. Groups keep the submission
+    // order of the passes.
+    uimax l_pass_count = m_frame_render_passes.count();
+    uimax l_group_begin = 0;
+    while (l_group_begin < l_pass_count) {
+      uimax l_group_end = l_group_begin + 1;
+      while (l_group_end < l_pass_count &&
+             !__render_pass_conflicts(l_group_begin, l_group_end)) {
+        l_group_end += 1;
       }
-
-      p_render_pass.for_each_commands([&](command_draw_call &p_command) {
-        command_draw_call_proxy l_draw_call(heap, &p_command);
-        indexbuffer *l_index_buffer = l_draw_call.IndexBuffer();
-        vertexbuffer *l_vertex_buffer = l_draw_call.VertexBuffer();
-        program_proxy l_program = l_draw_call.Program();
-        rast::algorithm::program l_rasterizer_program;
-        l_rasterizer_program.m_vertex =
-            l_program.VertexShader().m_shader->m_buffer->data;
-        l_rasterizer_program.m_fragment =
-            l_program.FragmentShader().m_shader->m_buffer->data;
-
-        rast::algorithm::program_uniforms l_vertex_uniforms =
-            __prepare_algorithm_uniforms(
-                l_draw_call.m_value->m_vertex_uniforms);
-
-        rast::algorithm::program_uniforms l_fragment_uniforms =
-            __prepare_algorithm_uniforms(
-                l_draw_call.m_value->m_fragment_uniforms);
-
-        rast::algorithm::rasterize_unit(
-            m_rasterize_heap, l_rasterizer_program,
-            p_render_pass.value()->m_rect, p_render_pass.value()->m_proj,
-            p_render_pass.value()->m_view, l_draw_call.value()->m_transform,
-            l_index_buffer->range(), l_vertex_buffer->layout,
-            l_vertex_buffer->range(), l_vertex_uniforms, l_fragment_uniforms,
-            l_draw_call.value()->m_state, l_draw_call.value()->m_rgba,
-            l_frame_rgb_texture.value()->m_info, l_frame_rgb_texture_range,
-            l_frame_depth_texture_info, l_frame_depth_texture_range)
-            .rasterize();
-      });
-    });
+      __render_pass_group(l_group_begin, l_group_end);
+      l_group_begin = l_group_end;
+    }
 
     proxy().for_each_renderpass([&](renderpass_proxy &p_render_passs) {
       p_render_passs.value()->m_commands.clear();
@@ -838,19 +962,264 @@ struct rast_impl_software {
     heap.m_uniform_command_stack.clear();
   };
 
-  void initialize() {
+  void initialize(uimax p_worker_count) {
     heap.allocate();
-    m_rasterize_heap.allocate();
+    m_rasterize_workers.allocate(p_worker_count);
+    m_rasterize_pass_workers.allocate(0);
+    m_rasterize_heaps.allocate(0);
+    m_frame_render_passes.allocate(0);
     m_command_temporary_stack.clear();
+    m_stats.allocate();
+    m_stats.reset();
   };
 
   void terminate() {
 
     heap.free();
-    m_rasterize_heap.free();
+    for (auto i = 0; i < m_rasterize_heaps.count(); ++i) {
+      m_rasterize_heaps.at(i).free();
+    }
+    m_rasterize_heaps.free();
+    m_frame_render_passes.free();
+    m_rasterize_workers.free();
+    for (uimax i = 0; i < m_rasterize_pass_workers.count(); ++i) {
+      container::span<thread_pool> &l_pass_workers =
+          m_rasterize_pass_workers.at(i);
+      for (uimax j = 0; j < l_pass_workers.count(); ++j) {
+        l_pass_workers.at(j).free();
+      }
+      l_pass_workers.free();
+    }
+    m_rasterize_pass_workers.free();
+    m_stats.free();
   };
 
 private:
+  // A pass rasterizes its tiles on the rasterize workers. The passes of a
+  // group are the tasks of the workers instead, each one with its own
+  // rasterize_heap, and their tiles are rasterized on their share of the
+  // workers.
+  void __render_pass_group(uimax p_begin, uimax p_end) {
+    uimax l_count = p_end - p_begin;
+    ui8 l_concurrent = l_count > 1 && m_rasterize_workers.worker_count() > 1;
+    uimax l_heap_count = l_concurrent ? l_count : 1;
+    while (m_rasterize_heaps.count() < l_heap_count) {
+      rast::algorithm::rasterize_heap l_rasterize_heap;
+      l_rasterize_heap.allocate(m_rasterize_workers.worker_count());
+      m_rasterize_heaps.push_back(l_rasterize_heap);
+    }
+
+    if (l_concurrent) {
+      container::span<thread_pool> &l_pass_workers =
+          __rasterize_pass_workers(l_count);
+      m_rasterize_workers.dispatch(l_count, [&](uimax p_task_index, uimax) {
+        renderpass_proxy l_render_pass =
+            __frame_render_pass(p_begin + p_task_index);
+        __render_pass(l_render_pass, m_rasterize_heaps.at(p_task_index),
+                      l_pass_workers.at(p_task_index));
+      });
+      m_stats.m_concurrent_passes += l_count;
+    } else {
+      for (auto i = p_begin; i < p_end; ++i) {
+        renderpass_proxy l_render_pass = __frame_render_pass(i);
+        __render_pass(l_render_pass, m_rasterize_heaps.at(0),
+                      m_rasterize_workers);
+      }
+    }
+
+    for (uimax i = 0; i < l_heap_count; ++i) {
+      m_rasterize_heaps.at(i).collect_stats(m_stats);
+      m_rasterize_heaps.at(i).reset_stats();
+    }
+  };
+
+  // Every pass gets worker_count / p_pass_count workers, the remaining ones go
+  // to the first passes. Passes that get a single worker rasterize inline.
+  container::span<thread_pool> &__rasterize_pass_workers(uimax p_pass_count) {
+    while (m_rasterize_pass_workers.count() < p_pass_count) {
+      container::span<thread_pool> l_pass_workers;
+      l_pass_workers.allocate(0);
+      m_rasterize_pass_workers.push_back(l_pass_workers);
+    }
+    container::span<thread_pool> &l_pass_workers =
+        m_rasterize_pass_workers.at(p_pass_count - 1);
+    if (l_pass_workers.count() == 0) {
+      uimax l_worker_count = m_rasterize_workers.worker_count();
+      l_pass_workers.realloc(p_pass_count);
+      for (uimax i = 0; i < p_pass_count; ++i) {
+        uimax l_pass_worker_count = (l_worker_count / p_pass_count) +
+                                    (i < (l_worker_count % p_pass_count));
+        l_pass_workers.at(i).allocate(
+            l_pass_worker_count == 0 ? 1 : l_pass_worker_count);
+      }
+    }
+    return l_pass_workers;
+  };
+
+  // The pass writes a texture of one of the passes from p_group_begin.
+  ui8 __render_pass_conflicts(uimax p_group_begin, uimax p_pass) {
+    framebuffer *l_frame_buffer =
+        __frame_render_pass(p_pass).FrameBuffer().m_value;
+    for (auto i = p_group_begin; i < p_pass; ++i) {
+      if (__framebuffer_shares_texture(
+              *l_frame_buffer, *__frame_render_pass(i).FrameBuffer().m_value)) {
+        return 1;
+      }
+    }
+    return 0;
+  };
+
+  renderpass_proxy __frame_render_pass(uimax p_index) {
+    return proxy().RenderPass(m_frame_render_passes.at(p_index));
+  };
+
+  static ui8 __framebuffer_shares_texture(const framebuffer &p_left,
+                                          const framebuffer &p_right) {
+    const bgfx::TextureHandle l_left[3] = {p_left.m_rgb, p_left.m_depth,
+                                           p_left.m_depth_max};
+    const bgfx::TextureHandle l_right[3] = {p_right.m_rgb, p_right.m_depth,
+                                            p_right.m_depth_max};
+    for (auto i = 0; i < 3; ++i) {
+      if (l_left[i].idx == bgfx::kInvalidHandle) {
+        continue;
+      }
+      for (auto j = 0; j < 3; ++j) {
+        if (l_left[i].idx == l_right[j].idx) {
+          return 1;
+        }
+      }
+    }
+    return 0;
+  };
+
+  void __render_pass(renderpass_proxy &p_render_pass,
+                     rast::algorithm::rasterize_heap &p_rasterize_heap,
+                     thread_pool &p_rasterize_workers) {
+    assert_debug(p_render_pass.value()->m_framebuffer.idx !=
+                 bgfx::kInvalidHandle);
+    framebuffer_proxy l_frame_buffer = p_render_pass.FrameBuffer();
+    texture_proxy l_frame_rgb_texture = l_frame_buffer.RGBTexture();
+    container::range<ui8> l_frame_rgb_texture_range =
+        l_frame_rgb_texture.value()->range();
+
+    container::range<ui8> l_frame_depth_texture_range;
+    bgfx::TextureInfo l_frame_depth_texture_info;
+    container::range<ui8> l_frame_depth_max_texture_range;
+    bgfx::TextureInfo l_frame_depth_max_texture_info;
+
+    if (l_frame_buffer.m_value->has_depth()) {
+      texture_proxy l_frame_depth_texture =
+          p_render_pass.FrameBuffer().DepthTexture();
+      l_frame_depth_texture_range = l_frame_depth_texture.value()->range();
+      l_frame_depth_texture_info = l_frame_depth_texture.value()->m_info;
+      texture_proxy l_frame_depth_max_texture =
+          p_render_pass.FrameBuffer().DepthMaxTexture();
+      l_frame_depth_max_texture_range =
+          l_frame_depth_max_texture.value()->range();
+      l_frame_depth_max_texture_info =
+          l_frame_depth_max_texture.value()->m_info;
+    } else {
+      l_frame_depth_texture_range = container::range<ui8>::make(0, 0);
+      l_frame_depth_texture_info.bitsPerPixel = 0;
+      l_frame_depth_max_texture_range = container::range<ui8>::make(0, 0);
+      l_frame_depth_max_texture_info.bitsPerPixel = 0;
+    }
+
+    // Clears are applied to the tiles when they are first drawn or read.
+    {
+      const clear_state &l_clear_state = p_render_pass.value()->m_clear;
+      ui8 l_clear_flags = 0;
+      if (l_clear_state.m_flags.m_color) {
+        l_clear_flags |= rast::algorithm::target_clear::s_color;
+      }
+      if (l_clear_state.m_flags.m_depth) {
+        assert_debug(l_frame_buffer.m_value->has_depth());
+        l_clear_flags |= rast::algorithm::target_clear::s_depth;
+      }
+      l_frame_buffer.m_value->m_clear.clear(
+          l_clear_flags,
+          rgb_t{l_clear_state.m_rgba.r, l_clear_state.m_rgba.g,
+                l_clear_state.m_rgba.b},
+          l_clear_state.m_depth);
+    }
+
+    auto l_resolve_deferred_draws = [&]() {
+      if (p_rasterize_heap.m_deferred.m_draws.count() > 0) {
+        rast::algorithm::resolve_unit(
+            p_rasterize_heap, p_rasterize_workers,
+            l_frame_rgb_texture.value()->m_info, l_frame_rgb_texture_range)
+            .resolve();
+      }
+    };
+
+    p_render_pass.for_each_commands([&](command_draw_call &p_command) {
+      command_draw_call_proxy l_draw_call(heap, &p_command);
+      indexbuffer *l_index_buffer = l_draw_call.IndexBuffer();
+      vertexbuffer *l_vertex_buffer = l_draw_call.VertexBuffer();
+
+      if (l_vertex_buffer->has_bounds &&
+          rast::algorithm::frustum::is_outside(
+              p_render_pass.value()->m_proj * p_render_pass.value()->m_view *
+                  l_draw_call.value()->m_transform,
+              l_vertex_buffer->bounds)) {
+        p_rasterize_heap.m_culled_draws += 1;
+        return;
+      }
+
+      program_proxy l_program = l_draw_call.Program();
+      rast::algorithm::program l_rasterizer_program;
+      l_rasterizer_program.m_vertex =
+          l_program.VertexShader().m_shader->m_buffer->data;
+      l_rasterizer_program.m_fragment =
+          l_program.FragmentShader().m_shader->m_buffer->data;
+
+      rast::algorithm::program_uniforms l_vertex_uniforms =
+          __prepare_algorithm_uniforms(
+              l_draw_call.m_value->m_vertex_uniforms);
+
+      rast::algorithm::program_uniforms l_fragment_uniforms =
+          __prepare_algorithm_uniforms(
+              l_draw_call.m_value->m_fragment_uniforms);
+
+      // The rasterize_unit keeps references to the buffer ranges.
+      container::range<ui8> l_index_buffer_range = l_index_buffer->range();
+      container::range<ui8> l_vertex_buffer_range = l_vertex_buffer->range();
+      rast::algorithm::rasterize_unit l_rasterize_unit(
+          p_rasterize_heap, p_rasterize_workers, l_rasterizer_program,
+          p_render_pass.value()->m_rect, p_render_pass.value()->m_proj,
+          p_render_pass.value()->m_view, l_draw_call.value()->m_transform,
+          l_index_buffer_range, l_index_buffer->min_index,
+          l_index_buffer->max_index, l_vertex_buffer->layout,
+          l_vertex_buffer_range, l_vertex_uniforms, l_fragment_uniforms,
+          l_draw_call.value()->m_state, l_draw_call.value()->m_rgba,
+          l_frame_rgb_texture.value()->m_info, l_frame_rgb_texture_range,
+          l_frame_depth_texture_info, l_frame_depth_texture_range,
+          l_frame_depth_max_texture_info, l_frame_depth_max_texture_range,
+          l_frame_buffer.m_value->m_clear);
+
+      if (p_render_pass.value()->m_deferred &&
+          rast::algorithm::render_state::from_int(
+              l_draw_call.value()->m_state)
+              .m_opaque) {
+        l_rasterize_unit.rasterize_deferred();
+      } else {
+        // Deferred draws submitted before are shaded first to keep the
+        // submission order.
+        l_resolve_deferred_draws();
+        l_rasterize_unit.rasterize();
+      }
+    });
+
+    l_resolve_deferred_draws();
+  };
+
+  rast::image_view __texture_view(texture_proxy p_texture) {
+    texture *l_texture = p_texture.value();
+    return rast::image_view(l_texture->m_info.width, l_texture->m_info.height,
+                            l_texture->m_info.bitsPerPixel,
+                            l_texture->range());
+  };
+
   container::range<ui8> __get_uniform(uimax p_hash) {
     auto &l_uniform =
         heap.m_uniforms.by_index.at(heap.m_uniforms.by_key.at(p_hash));
@@ -925,8 +1294,9 @@ private:
 };
 
 FORCE_INLINE ui8 rast_api_init(rast_impl_software *thiz,
-                               const bgfx::Init &p_init = {}) {
-  thiz->initialize();
+                               const bgfx::Init &p_init = {},
+                               uint16_t _workerCount = 0) {
+  thiz->initialize(_workerCount);
   return 1;
 };
 
@@ -970,7 +1340,8 @@ FORCE_INLINE bgfx::FrameBufferHandle rast_api_createFrameBuffer(
     rast_impl_software *thiz, void *_nwh, uint16_t _width, uint16_t _height,
     bgfx::TextureFormat::Enum _format = bgfx::TextureFormat::Count,
     bgfx::TextureFormat::Enum _depthFormat = bgfx::TextureFormat::Count) {
-  return thiz->allocate_frame_buffer(_width, _height, _format, _depthFormat);
+  return thiz->allocate_frame_buffer(_width, _height, _format, _depthFormat,
+                                     _nwh);
 };
 
 FORCE_INLINE void rast_api_destroy(rast_impl_software *thiz,
@@ -984,9 +1355,16 @@ rast_api_getTexture(rast_impl_software *thiz, bgfx::FrameBufferHandle _handle,
   return thiz->get_texture(_handle);
 };
 
+FORCE_INLINE uintptr_t
+rast_api_overrideInternal(rast_impl_software *thiz,
+                          bgfx::TextureHandle _handle, uintptr_t _ptr) {
+  return thiz->override_texture_memory(_handle, (ui8 *)_ptr);
+};
+
 FORCE_INLINE container::range<ui8>
 rast_api_fetchTextureSync(rast_impl_software *thiz,
                           bgfx::TextureHandle _texture) {
+  thiz->materialize_clears(_texture);
   return thiz->proxy().Texture(_texture).value()->range();
 };
 
@@ -1072,6 +1450,18 @@ FORCE_INLINE void rast_api_setViewClear(rast_impl_software *thiz,
   thiz->view_set_clear(_id, _flags, _rgba, _depth);
 };
 
+FORCE_INLINE void
+rast_api_setVertexBufferBounds(rast_impl_software *thiz,
+                               bgfx::VertexBufferHandle _handle,
+                               const bounding_volume &_bounds) {
+  thiz->vertex_buffer_set_bounds(_handle, _bounds);
+};
+
+FORCE_INLINE void rast_api_setViewDeferred(rast_impl_software *thiz,
+                                           bgfx::ViewId _id, bool _deferred) {
+  thiz->view_set_deferred(_id, _deferred);
+};
+
 FORCE_INLINE void rast_api_setViewTransform(rast_impl_software *thiz,
                                             bgfx::ViewId _id, const void *_view,
                                             const void *_proj) {
@@ -1113,4 +1503,9 @@ FORCE_INLINE uint32_t rast_api_frame(rast_impl_software *thiz,
                                      bool _capture = false) {
   thiz->frame();
   return 0;
+};
+
+FORCE_INLINE const rast::frame_stats &
+rast_api_getStats(rast_impl_software *thiz) {
+  return thiz->m_stats;
 };
\ No newline at end of file
@@ -5,6 +5,14 @@
 #include <m/mat.hpp>
 #include <m/rect.hpp>
 #include <shared/types.hpp>
+#include <sys/thread.hpp>
+
+#if !PLATFORM_WEBASSEMBLY_PREPROCESS && defined(__SSE2__)
+#define RAST_STRETCH_SSE2 1
+#include <emmintrin.h>
+#else
+#define RAST_STRETCH_SSE2 0
+#endif
 
 inline ui8 textureformat_to_pixel_size(bgfx::TextureFormat::Enum p_format) {
   switch (p_format) {
@@ -15,6 +23,7 @@ inline ui8 textureformat_to_pixel_size(bgfx::TextureFormat::Enum p_format) {
   case bgfx::TextureFormat::Enum::RGB8:
     return sizeof(ui8) * 3;
   case bgfx::TextureFormat::Enum::RGBA8:
+  case bgfx::TextureFormat::Enum::BGRA8:
     return sizeof(ui8) * 4;
   case bgfx::TextureFormat::Enum::D32F:
     return sizeof(fix32);
@@ -41,22 +50,6 @@ struct attrib_type : bgfx::AttribType {
   };
 };
 
-// TODO -> improve that
-static void image_copy_stretch(rgb_t *p_from, ui16 p_from_width,
-                               ui16 p_from_height, rgba_t *p_to,
-                               ui16 p_to_width, ui16 p_to_height) {
-  fix32 l_width_delta_ratio = fix32(p_from_width) / p_to_width;
-  fix32 l_height_delta_ratio = fix32(p_from_height) / p_to_height;
-  for (auto y = 0; y < p_to_height; ++y) {
-    ui16 l_from_y = ui16(l_height_delta_ratio * y);
-    for (auto x = 0; x < p_to_width; ++x) {
-      ui16 l_from_x = ui16(l_width_delta_ratio * x);
-      *(rgb_t *)&p_to[x + (y * p_to_width)] =
-          p_from[l_from_x + (l_from_y * p_from_height)];
-    }
-  }
-};
-
 struct image_view {
   ui16 m_width;
   ui16 m_height;
@@ -121,6 +114,314 @@ struct image_view {
   };
 };
 
+// Scaled copy of an image into a 32 bits image of another size. Source columns
+// are computed once per copy in m_columns, source rows once per destination
+// row, and rows are copied in bands dispatched to the workers.
+// Sources are either RGB8 or 32 bits images with the same layout as the
+// destination. RGB8 sources are widened with an opaque alpha.
+struct image_stretch {
+  enum class filter { Nearest = 0, Bilinear = 1 };
+
+private:
+  // Source columns (or rows) sampled by a destination pixel, and the 8 bits
+  // weight of m_x1. Nearest sampling only reads m_x0.
+  struct column {
+    ui16 m_x0;
+    ui16 m_x1;
+    ui16 m_weight;
+  };
+
+  container::span<column> m_columns;
+
+  inline static constexpr ui16 s_band_height = 16;
+
+public:
+  void allocate() { m_columns.allocate(0); };
+  void free() { m_columns.free(); };
+
+  void copy(const image_view &p_from, image_view &p_to, filter p_filter,
+            thread_pool &p_workers) {
+    assert_debug(p_to.m_bits_per_pixel == sizeof(ui32));
+    assert_debug(p_from.m_bits_per_pixel == sizeof(ui32) ||
+                 p_from.m_bits_per_pixel == sizeof(rgb_t));
+    if (p_from.m_bits_per_pixel == sizeof(ui32)) {
+      __copy<sizeof(ui32)>(p_from, p_to, p_filter, p_workers);
+    } else {
+      __copy<sizeof(rgb_t)>(p_from, p_to, p_filter, p_workers);
+    }
+  };
+
+private:
+  // Source position of the destination pixel p_index, sampled at the pixel
+  // centers and clamped to the source edges.
+  static ui32 __position(ui16 p_index, ui16 p_from_size, ui16 p_to_size) {
+    i64 l_position =
+        ((i64(p_index) * 2 + 1) * p_from_size << 15) / p_to_size - (1 << 15);
+    i64 l_max = i64(p_from_size - 1) << 16;
+    l_position = l_position < 0 ? 0 : l_position;
+    l_position = l_position > l_max ? l_max : l_position;
+    return ui32(l_position);
+  };
+
+  static column __column(filter p_filter, ui16 p_index, ui16 p_from_size,
+                         ui16 p_to_size) {
+    column l_column;
+    if (p_filter == filter::Nearest) {
+      l_column.m_x0 = ui16((ui32(p_index) * p_from_size) / p_to_size);
+      l_column.m_x1 = l_column.m_x0;
+      l_column.m_weight = 0;
+    } else {
+      ui32 l_position = __position(p_index, p_from_size, p_to_size);
+      l_column.m_x0 = ui16(l_position >> 16);
+      l_column.m_x1 = l_column.m_x0 + (l_column.m_x0 + 1 < p_from_size);
+      l_column.m_weight = ui16((l_position >> 8) & 0xFF);
+    }
+    return l_column;
+  };
+
+  template <ui8 FromBytes>
+  void __copy(const image_view &p_from, image_view &p_to, filter p_filter,
+              thread_pool &p_workers) {
+    m_columns.resize(p_to.m_width);
+    for (auto x = 0; x < p_to.m_width; ++x) {
+      m_columns.at(x) = __column(p_filter, x, p_from.m_width, p_to.m_width);
+    }
+
+    uimax l_band_count = (p_to.m_height + s_band_height - 1) / s_band_height;
+    p_workers.dispatch(l_band_count, [&](uimax p_band, uimax) {
+      ui16 l_begin = ui16(p_band * s_band_height);
+      ui16 l_end = l_begin + s_band_height;
+      l_end = l_end > p_to.m_height ? p_to.m_height : l_end;
+      for (ui16 y = l_begin; y < l_end; ++y) {
+        column l_row = __column(p_filter, y, p_from.m_height, p_to.m_height);
+        const ui8 *l_row_0 =
+            p_from.m_buffer.m_begin + l_row.m_x0 * p_from.stride();
+        const ui8 *l_row_1 =
+            p_from.m_buffer.m_begin + l_row.m_x1 * p_from.stride();
+        ui8 *l_to = p_to.m_buffer.m_begin + y * p_to.stride();
+        if (p_filter == filter::Nearest) {
+          __nearest_row<FromBytes>(l_row_0, l_to, p_to.m_width);
+        } else {
+          __bilinear_row<FromBytes>(l_row_0, l_row_1, l_row.m_weight, l_to,
+                                    p_to.m_width);
+        }
+      }
+    });
+  };
+
+  template <ui8 FromBytes>
+  void __nearest_row(const ui8 *p_from, ui8 *p_to, ui16 p_width) {
+    column *l_columns = m_columns.m_data;
+    if constexpr (FromBytes == sizeof(ui32)) {
+      const ui32 *l_from = (const ui32 *)p_from;
+      ui32 *l_to = (ui32 *)p_to;
+      for (auto x = 0; x < p_width; ++x) {
+        l_to[x] = l_from[l_columns[x].m_x0];
+      }
+    } else {
+      ui16 x = 0;
+#if RAST_STRETCH_SSE2
+      // Four gathered pixels are widened with a single or and stored at once.
+      const __m128i l_alpha = _mm_set1_epi32(i32(0xFF000000));
+      for (; x + 4 <= p_width; x += 4) {
+        __m128i l_pixels = _mm_setr_epi32(
+            __rgb(p_from, l_columns[x].m_x0),
+            __rgb(p_from, l_columns[x + 1].m_x0),
+            __rgb(p_from, l_columns[x + 2].m_x0),
+            __rgb(p_from, l_columns[x + 3].m_x0));
+        _mm_storeu_si128((__m128i *)(p_to + x * sizeof(ui32)),
+                         _mm_or_si128(l_pixels, l_alpha));
+      }
+#endif
+      for (; x < p_width; ++x) {
+        const ui8 *l_pixel = p_from + l_columns[x].m_x0 * FromBytes;
+        ui8 *l_to = p_to + x * sizeof(ui32);
+        l_to[0] = l_pixel[0];
+        l_to[1] = l_pixel[1];
+        l_to[2] = l_pixel[2];
+        l_to[3] = 255;
+      }
+    }
+  };
+
+  // RGB8 pixel p_x of the row in the low bytes of a little endian ui32, the
+  // byte after the pixel is not read.
+  static i32 __rgb(const ui8 *p_row, ui16 p_x) {
+    const ui8 *l_pixel = p_row + p_x * sizeof(rgb_t);
+    return i32(ui32(l_pixel[0]) | (ui32(l_pixel[1]) << 8) |
+               (ui32(l_pixel[2]) << 16));
+  };
+
+  template <ui8 FromBytes>
+  void __bilinear_row(const ui8 *p_from_0, const ui8 *p_from_1,
+                      ui16 p_weight_y, ui8 *p_to, ui16 p_width) {
+    column *l_columns = m_columns.m_data;
+    ui32 l_weight_y_0 = 256 - p_weight_y;
+    for (auto x = 0; x < p_width; ++x) {
+      const column &l_column = l_columns[x];
+      ui32 l_weight_x_0 = 256 - l_column.m_weight;
+      const ui8 *l_00 = p_from_0 + l_column.m_x0 * FromBytes;
+      const ui8 *l_01 = p_from_0 + l_column.m_x1 * FromBytes;
+      const ui8 *l_10 = p_from_1 + l_column.m_x0 * FromBytes;
+      const ui8 *l_11 = p_from_1 + l_column.m_x1 * FromBytes;
+      ui8 *l_to = p_to + x * sizeof(ui32);
+      for (auto c = 0; c < FromBytes; ++c) {
+        ui32 l_top = l_00[c] * l_weight_x_0 + l_01[c] * l_column.m_weight;
+        ui32 l_bottom = l_10[c] * l_weight_x_0 + l_11[c] * l_column.m_weight;
+        l_to[c] = ui8((l_top * l_weight_y_0 + l_bottom * p_weight_y) >> 16);
+      }
+      if constexpr (FromBytes != sizeof(ui32)) {
+        l_to[3] = 255;
+      }
+    }
+  };
+};
+
+// Pixel layouts of the color targets. A pixel is the low bytes of a ui32 on a
+// little endian host, so RGBA8 and BGRA8 pixels are written with a single
+// aligned store. Their alpha is opaque.
+struct color_format {
+  static ui8 is_supported(bgfx::TextureFormat::Enum p_format) {
+    return p_format == bgfx::TextureFormat::RGB8 ||
+           p_format == bgfx::TextureFormat::RGBA8 ||
+           p_format == bgfx::TextureFormat::BGRA8;
+  };
+
+  template <bgfx::TextureFormat::Enum Format>
+  static ui32 pixel(const rgb_t &p_color) {
+    if constexpr (Format == bgfx::TextureFormat::BGRA8) {
+      return ui32(p_color.z()) | (ui32(p_color.y()) << 8) |
+             (ui32(p_color.x()) << 16) | (ui32(0xFF) << 24);
+    } else if constexpr (Format == bgfx::TextureFormat::RGBA8) {
+      return ui32(p_color.x()) | (ui32(p_color.y()) << 8) |
+             (ui32(p_color.z()) << 16) | (ui32(0xFF) << 24);
+    } else {
+      return ui32(p_color.x()) | (ui32(p_color.y()) << 8) |
+             (ui32(p_color.z()) << 16);
+    }
+  };
+
+  static ui32 pixel(bgfx::TextureFormat::Enum p_format, const rgb_t &p_color) {
+    switch (p_format) {
+    case bgfx::TextureFormat::BGRA8:
+      return pixel<bgfx::TextureFormat::BGRA8>(p_color);
+    case bgfx::TextureFormat::RGBA8:
+      return pixel<bgfx::TextureFormat::RGBA8>(p_color);
+    default:
+      assert_debug(p_format == bgfx::TextureFormat::RGB8);
+      return pixel<bgfx::TextureFormat::RGB8>(p_color);
+    }
+  };
+
+  // The format is resolved once for the p_count pixels.
+  static void write(image_view &p_target, bgfx::TextureFormat::Enum p_format,
+                    const uimax *p_pixels, const rgb_t *p_colors,
+                    uimax p_count) {
+    switch (p_format) {
+    case bgfx::TextureFormat::BGRA8:
+      __write<bgfx::TextureFormat::BGRA8>(p_target, p_pixels, p_colors,
+                                          p_count);
+      break;
+    case bgfx::TextureFormat::RGBA8:
+      __write<bgfx::TextureFormat::RGBA8>(p_target, p_pixels, p_colors,
+                                          p_count);
+      break;
+    default:
+      assert_debug(p_format == bgfx::TextureFormat::RGB8);
+      for (auto i = 0; i < p_count; ++i) {
+        p_target.set_pixel(p_pixels[i], p_colors[i]);
+      }
+      break;
+    }
+  };
+
+private:
+  template <bgfx::TextureFormat::Enum Format>
+  static void __write(image_view &p_target, const uimax *p_pixels,
+                      const rgb_t *p_colors, uimax p_count) {
+    assert_debug(p_target.m_bits_per_pixel == sizeof(ui32));
+    ui32 *l_target = (ui32 *)p_target.m_buffer.m_begin;
+    for (auto i = 0; i < p_count; ++i) {
+      assert_debug(p_pixels[i] < p_target.pixel_count());
+      l_target[p_pixels[i]] = pixel<Format>(p_colors[i]);
+    }
+  };
+};
+
+// Counters of the last frame, reset by every frame.
+struct frame_stats {
+  // Hierarchical depth rejection. Polygons are tested once per screen tile and
+  // blocks once per depth max cell, rejected ones are not rasterized.
+  struct depth_max {
+    uimax m_polygon_tested;
+    uimax m_polygon_rejected;
+    uimax m_block_tested;
+    uimax m_block_rejected;
+
+    void reset() {
+      m_polygon_tested = 0;
+      m_polygon_rejected = 0;
+      m_block_tested = 0;
+      m_block_rejected = 0;
+    };
+
+    void add(const depth_max &p_other) {
+      m_polygon_tested += p_other.m_polygon_tested;
+      m_polygon_rejected += p_other.m_polygon_rejected;
+      m_block_tested += p_other.m_block_tested;
+      m_block_rejected += p_other.m_block_rejected;
+    };
+  } m_depth_max;
+
+  // Vertex shading of a draw call. Only the vertices between the smallest and
+  // greatest index of the index buffer are shaded. When the index buffer has
+  // fewer indices than this range has vertices, the vertices are shaded on
+  // demand: each vertex referenced by the index buffer is shaded once.
+  struct vertex_shading {
+    ui8 m_on_demand;
+    uimax m_vertex_count;
+    uimax m_index_count;
+    // Indices whose vertex was already shaded for the draw.
+    uimax m_reused;
+    // Vertex function calls.
+    uimax m_shaded;
+  };
+  // One entry per draw call, in submission order.
+  container::vector<vertex_shading> m_draws;
+
+  // Draws of deferred views only write the visibility buffer. Visible pixels
+  // are interpolated and shaded once, when the render pass is resolved.
+  struct deferred {
+    uimax m_draws;
+    // Fragment shader invocations of the resolves.
+    uimax m_shaded;
+
+    void reset() {
+      m_draws = 0;
+      m_shaded = 0;
+    };
+  } m_deferred;
+
+  // Draws skipped because their vertex buffer bounds are outside of the view
+  // frustum.
+  uimax m_culled_draws;
+
+  // Render passes rendered concurrently with the other passes of their group,
+  // on their share of the workers.
+  uimax m_concurrent_passes;
+
+  void allocate() { m_draws.allocate(0); };
+  void free() { m_draws.free(); };
+
+  void reset() {
+    m_depth_max.reset();
+    m_draws.clear();
+    m_deferred.reset();
+    m_culled_draws = 0;
+    m_concurrent_passes = 0;
+  };
+};
+
 using uniform_vec4_t = m::vec<fix32, 4>;
 
 inline static uimax uniform_type_get_size(bgfx::UniformType::Enum p_type) {
@@ -167,9 +468,27 @@ using shader_vertex_function = void (*)(const shader_vertex_runtime_ctx &p_ctx,
                                         m::vec<fix32, 4> &out_screen_position,
                                         ui8 **out_vertex);
 
+// Optional vertex entry point that processes p_count consecutive vertices of
+// the vertex buffer, starting at p_vertices. Outputs are structure of arrays,
+// out_screen_positions[c][i] is the component c of the i-th vertex position and
+// out_vertex[o] points to the p_count consecutive values of the vertex output
+// o.
+using shader_vertex_batch_function =
+    void (*)(const shader_vertex_runtime_ctx &p_ctx, const ui8 *p_vertices,
+             uimax p_count, ui8 **p_uniforms, fix32 **out_screen_positions,
+             ui8 **out_vertex);
+
 using shader_fragment_function = void (*)(ui8 **p_vertex_output_interpolated,
                                           ui8 **p_uniforms, rgbf_t &out_color);
 
+// Optional fragment entry point that shades a span of p_count visible pixels.
+// Inputs are structure of arrays, p_vertex_output_interpolated[o] points to
+// the p_count consecutive interpolated values of the vertex output o.
+// out_colors receives one packed color per pixel.
+using shader_fragment_batch_function =
+    void (*)(ui8 **p_vertex_output_interpolated, uimax p_count,
+             ui8 **p_uniforms, rgb_t *out_colors);
+
 struct shader_vertex {
   const shader_vertex_runtime_ctx &m_ctx;
 
@@ -177,6 +496,13 @@ struct shader_vertex {
   const T &get_vertex(bgfx::Attrib::Enum p_attrib, const ui8 *p_vertex) {
     return *(T *)(p_vertex + m_ctx.m_vertex_layout.m_offset[p_attrib]);
   };
+
+  template <typename T>
+  const T &get_vertex(bgfx::Attrib::Enum p_attrib, const ui8 *p_vertices,
+                      uimax p_index) {
+    return get_vertex<T>(p_attrib, p_vertices + (p_index *
+                                                 m_ctx.m_vertex_layout.m_stride));
+  };
 };
 
 struct shader_vertex_output_parameter {
@@ -204,12 +530,16 @@ struct shader_vertex_output_parameter {
 
 struct shader_vertex_bytes {
 
+  // Maximum vertex count of a shader_vertex_batch_function call.
+  inline static constexpr ui8 s_batch_size = 64;
+
   struct byte_header {
     uimax m_uniform_count;
     uimax m_uniform_array;
     uimax m_vertex_output_count;
     uimax m_vertex_output_array;
     uimax m_vertex_function;
+    uimax m_vertex_batch_function;
     uimax m_end;
 
     uimax size_of() { return m_end; };
@@ -231,8 +561,10 @@ struct shader_vertex_bytes {
         (p_output_parameter_count * sizeof(shader_vertex_output_parameter));
     l_byte_header.m_vertex_function +=
         algorithm::alignment_offset(l_byte_header.m_vertex_function, 8);
-    l_byte_header.m_end =
+    l_byte_header.m_vertex_batch_function =
         l_byte_header.m_vertex_function + sizeof(shader_vertex_function);
+    l_byte_header.m_end = l_byte_header.m_vertex_batch_function +
+                          sizeof(shader_vertex_batch_function);
     return l_byte_header;
   };
 
@@ -243,7 +575,8 @@ struct shader_vertex_bytes {
               const container::range<shader_uniform> &p_uniforms,
               const container::range<shader_vertex_output_parameter>
                   &p_output_parameters,
-              shader_vertex_function p_function) {
+              shader_vertex_function p_function,
+              shader_vertex_batch_function p_batch_function) {
       byte_header *l_byte_header = (byte_header *)m_data;
       *l_byte_header = p_byte_header;
 
@@ -274,6 +607,12 @@ struct shader_vertex_bytes {
       shader_vertex_function *l_function =
           (shader_vertex_function *)(m_data + l_byte_header->m_vertex_function);
       *l_function = p_function;
+
+      shader_vertex_batch_function *l_batch_function =
+          (shader_vertex_batch_function *)(m_data +
+                                           l_byte_header
+                                               ->m_vertex_batch_function);
+      *l_batch_function = p_batch_function;
     };
 
     container::range<shader_vertex_output_parameter> output_parameters() {
@@ -300,15 +639,27 @@ struct shader_vertex_bytes {
       return *(shader_vertex_function *)(m_data +
                                          l_byte_header->m_vertex_function);
     };
+
+    // 0 when the shader has no batched entry point.
+    shader_vertex_batch_function batch_function() {
+      byte_header *l_byte_header = (byte_header *)m_data;
+      return *(shader_vertex_batch_function *)(m_data +
+                                               l_byte_header
+                                                   ->m_vertex_batch_function);
+    };
   };
 };
 
 struct shader_fragment_bytes {
 
+  // Maximum pixel count of a shader_fragment_batch_function call.
+  inline static constexpr ui8 s_batch_size = 64;
+
   struct byte_header {
     uimax m_uniform_count;
     uimax m_uniform_array;
     uimax m_fragment_function;
+    uimax m_fragment_batch_function;
     uimax m_end;
 
     uimax size_of() { return m_end; };
@@ -324,8 +675,10 @@ struct shader_fragment_bytes {
         (p_uniform_count * sizeof(shader_uniform));
     l_byte_header.m_fragment_function +=
         algorithm::alignment_offset(l_byte_header.m_fragment_function, 8);
-    l_byte_header.m_end =
+    l_byte_header.m_fragment_batch_function =
         l_byte_header.m_fragment_function + sizeof(shader_fragment_function);
+    l_byte_header.m_end = l_byte_header.m_fragment_batch_function +
+                          sizeof(shader_fragment_batch_function);
     return l_byte_header;
   };
 
@@ -334,7 +687,8 @@ struct shader_fragment_bytes {
 
     void fill(const byte_header &p_header,
               const container::range<shader_uniform> &p_uniforms,
-              shader_fragment_function p_function) {
+              shader_fragment_function p_function,
+              shader_fragment_batch_function p_batch_function) {
       *(byte_header *)(m_data) = p_header;
       *(uimax *)(m_data + p_header.m_uniform_count) = p_uniforms.count();
       if (p_uniforms.count() > 0) {
@@ -345,6 +699,9 @@ struct shader_fragment_bytes {
 
       *(shader_fragment_function *)(m_data + p_header.m_fragment_function) =
           p_function;
+      *(shader_fragment_batch_function *)(m_data +
+                                          p_header.m_fragment_batch_function) =
+          p_batch_function;
     };
 
     shader_fragment_function fonction() {
@@ -353,6 +710,13 @@ struct shader_fragment_bytes {
                                            l_byte_header->m_fragment_function);
     };
 
+    // 0 when the shader has no batched entry point.
+    shader_fragment_batch_function batch_function() {
+      byte_header *l_byte_header = (byte_header *)m_data;
+      return *(shader_fragment_batch_function
+                   *)(m_data + l_byte_header->m_fragment_batch_function);
+    };
+
     container::range<shader_uniform> uniforms() {
       byte_header *l_byte_header = (byte_header *)m_data;
       container::range<shader_uniform> l_range;
@@ -364,4 +728,6 @@ struct shader_fragment_bytes {
   };
 };
 
-} // namespace rast
\ No newline at end of file
+} // namespace rast
+
+#undef RAST_STRETCH_SSE2
\ No newline at end of file
@@ -17,6 +17,12 @@ template <typename Private> struct rast_api {
     return rast_api_init(&thiz, p_init);
   };
 
+  // Not part of bgfx. _workerCount is the number of threads used to rasterize
+  // draw calls, 0 means one per hardware thread.
+  FORCE_INLINE ui8 init(const bgfx::Init &p_init, uint16_t _workerCount) {
+    return rast_api_init(&thiz, p_init, _workerCount);
+  };
+
   FORCE_INLINE void shutdown() { rast_api_shutdown(&thiz); };
 
   FORCE_INLINE const bgfx::Memory *alloc(uint32_t _size) {
@@ -49,6 +55,9 @@ template <typename Private> struct rast_api {
                                       _textureFlags);
   };
 
+  // The software rasterizer has no native window, _nwh is the memory of the
+  // color attachment when it is not null. It holds _width * _height pixels of
+  // _format and must outlive the frame buffer.
   FORCE_INLINE bgfx::FrameBufferHandle createFrameBuffer(
       void *_nwh, uint16_t _width, uint16_t _height,
       bgfx::TextureFormat::Enum _format = bgfx::TextureFormat::Count,
@@ -66,6 +75,14 @@ template <typename Private> struct rast_api {
     return rast_api_getTexture(&thiz, _handle, _attachment);
   };
 
+  // The memory of a texture created from external memory (see the _nwh frame
+  // buffer) is moved to _ptr, which holds the same number of pixels. Returns
+  // the previous memory.
+  FORCE_INLINE uintptr_t overrideInternal(bgfx::TextureHandle _handle,
+                                          uintptr_t _ptr) {
+    return rast_api_overrideInternal(&thiz, _handle, _ptr);
+  };
+
   FORCE_INLINE container::range<ui8>
   fetchTextureSync(bgfx::TextureHandle _texture) {
     return rast_api_fetchTextureSync(&thiz, _texture);
@@ -78,6 +95,13 @@ template <typename Private> struct rast_api {
     return rast_api_createVertexBuffer(&thiz, _mem, _layout, _flags);
   };
 
+  // Not part of bgfx. Draws of the vertex buffer are skipped when its local
+  // space bounds are outside of the view frustum.
+  FORCE_INLINE void setVertexBufferBounds(bgfx::VertexBufferHandle _handle,
+                                          const bounding_volume &_bounds) {
+    rast_api_setVertexBufferBounds(&thiz, _handle, _bounds);
+  };
+
   FORCE_INLINE void destroy(bgfx::VertexBufferHandle _handle) {
     rast_api_destroy(&thiz, _handle);
   };
@@ -141,6 +165,12 @@ template <typename Private> struct rast_api {
     rast_api_setViewClear(&thiz, _id, _flags, _rgba, _depth);
   };
 
+  // Not part of bgfx. Opaque draws of a deferred view are shaded once per
+  // visible pixel when the view is rendered instead of once per draw.
+  FORCE_INLINE void setViewDeferred(bgfx::ViewId _id, bool _deferred) {
+    rast_api_setViewDeferred(&thiz, _id, _deferred);
+  };
+
   FORCE_INLINE void setViewTransform(bgfx::ViewId _id, const void *_view,
                                      const void *_proj) {
     rast_api_setViewTransform(&thiz, _id, _view, _proj);
@@ -174,6 +204,10 @@ template <typename Private> struct rast_api {
   FORCE_INLINE uint32_t frame(bool _capture = false) {
     return rast_api_frame(&thiz, _capture);
   };
+
+  FORCE_INLINE const rast::frame_stats &getStats() {
+    return rast_api_getStats(&thiz);
+  };
 };
 
 namespace bgfx {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <ren/program_definition.hpp>
 #include <ren/ren.hpp>
 
 namespace ren {
@@ -38,8 +39,10 @@ program_create_from_shaderdefinition(ren_api<Renderer> p_ren,
       p_meta, ShaderDefinitionType::s_meta.m_vertex_uniforms.range(),
       ShaderDefinitionType::s_meta.m_vertex_output.range(),
       ShaderDefinitionType::vertex,
+      program_vertex_batch<ShaderDefinitionType>::value,
       ShaderDefinitionType::s_meta.m_fragment_uniforms.range(),
-      ShaderDefinitionType::fragment, p_rast);
+      ShaderDefinitionType::fragment,
+      program_fragment_batch<ShaderDefinitionType>::value, p_rast);
 };
 
 } // namespace algorithm
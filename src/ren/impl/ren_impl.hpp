@@ -9,14 +9,15 @@
 namespace ren {
 namespace details {
 
-static constexpr bgfx::TextureFormat::Enum s_camera_rgb_format =
-    bgfx::TextureFormat::RGB8;
 static constexpr bgfx::TextureFormat::Enum s_camera_depth_format =
     bgfx::TextureFormat::D32F;
 
 struct camera {
   ui32 m_rendertexture_width;
   ui32 m_rendertexture_height;
+  bgfx::TextureFormat::Enum m_rgb_format;
+  // Memory of the color attachment when it is not owned by the frame buffer.
+  void *m_render_target;
 
   ui32 m_width;
   ui32 m_height;
@@ -168,17 +169,57 @@ struct ren_impl {
   void camera_set_render_width_height(camera_handle p_camera,
                                       ui32 p_rendertexture_width,
                                       ui32 p_rendertexture_height,
+                                      bgfx::TextureFormat::Enum p_rgb_format,
                                       rast_api<Rasterizer> p_rast) {
 
     camera *l_camera;
     bgfx::FrameBufferHandle *l_frame_buffer;
     m_heap.m_camera_table.at(p_camera.m_idx, &l_camera, &l_frame_buffer);
+    if (l_camera->m_rendertexture_width != 0) {
+      p_rast.destroy(*l_frame_buffer);
+    }
     l_camera->m_rendertexture_width = p_rendertexture_width;
     l_camera->m_rendertexture_height = p_rendertexture_height;
+    l_camera->m_rgb_format = p_rgb_format;
+    l_camera->m_render_target = 0;
+    *l_frame_buffer = __camera_create_frame_buffer(*l_camera, p_rast);
+  };
+
+  // The camera renders in p_target when it has the camera render size and
+  // color format, its frame is then read in place. Otherwise the camera renders
+  // in memory of its own. Nothing is done if the target is unchanged, and
+  // switching between two targets keeps the frame buffer.
+  template <typename Rasterizer>
+  void camera_set_render_target(camera_handle p_camera, void *p_target,
+                                ui32 p_width, ui32 p_height,
+                                bgfx::TextureFormat::Enum p_rgb_format,
+                                rast_api<Rasterizer> p_rast) {
+    camera *l_camera;
+    bgfx::FrameBufferHandle *l_frame_buffer;
+    m_heap.m_camera_table.at(p_camera.m_idx, &l_camera, &l_frame_buffer);
+    if (l_camera->m_rendertexture_width == 0) {
+      return;
+    }
+
+    void *l_target = 0;
+    if (p_width == l_camera->m_rendertexture_width &&
+        p_height == l_camera->m_rendertexture_height &&
+        p_rgb_format == l_camera->m_rgb_format) {
+      l_target = p_target;
+    }
+    if (l_target == l_camera->m_render_target) {
+      return;
+    }
+    if (l_target && l_camera->m_render_target) {
+      p_rast.overrideInternal(p_rast.getTexture(*l_frame_buffer),
+                              uintptr_t(l_target));
+      l_camera->m_render_target = l_target;
+      return;
+    }
 
-    *l_frame_buffer = p_rast.createFrameBuffer(
-        0, l_camera->m_rendertexture_width, l_camera->m_rendertexture_height,
-        s_camera_rgb_format, s_camera_depth_format);
+    p_rast.destroy(*l_frame_buffer);
+    l_camera->m_render_target = l_target;
+    *l_frame_buffer = __camera_create_frame_buffer(*l_camera, p_rast);
   };
 
   void camera_set_orthographic(camera_handle p_camera, fix32 p_width,
@@ -217,6 +258,10 @@ struct ren_impl {
     bgfx::IndexBufferHandle l_index_buffer;
     algorithm::upload_mesh_to_gpu(p_rast, p_mesh, &l_vertex_buffer,
                                   &l_index_buffer);
+    // Meshes without bounds are never culled.
+    if (p_mesh.m_has_bounds) {
+      p_rast.setVertexBufferBounds(l_vertex_buffer, p_mesh.m_bounds);
+    }
     uimax l_index =
         m_heap.m_mesh_table.push_back(l_vertex_buffer, l_index_buffer);
     return mesh_handle{.m_idx = l_index};
@@ -290,14 +335,18 @@ struct ren_impl {
       const container::range<rast::shader_vertex_output_parameter>
           &p_vertex_output,
       rast::shader_vertex_function p_vertex,
+      rast::shader_vertex_batch_function p_vertex_batch,
       const container::range<rast::shader_uniform> &p_fragment_uniforms,
-      rast::shader_fragment_function p_fragment, rast_api<Rasterizer> p_rast) {
+      rast::shader_fragment_function p_fragment,
+      rast::shader_fragment_batch_function p_fragment_batch,
+      rast_api<Rasterizer> p_rast) {
     auto l_vertex_shader_table = rast::shader_vertex_bytes::build_byte_header(
         p_vertex_uniforms.count(), p_vertex_output.count());
     const bgfx::Memory *l_vertex_shader_memory =
         p_rast.alloc(l_vertex_shader_table.size_of(), 8);
     rast::shader_vertex_bytes::view{l_vertex_shader_memory->data}.fill(
-        l_vertex_shader_table, p_vertex_uniforms, p_vertex_output, p_vertex);
+        l_vertex_shader_table, p_vertex_uniforms, p_vertex_output, p_vertex,
+        p_vertex_batch);
 
     auto l_fragment_shader_header =
         rast::shader_fragment_bytes::build_byte_header(
@@ -306,7 +355,8 @@ struct ren_impl {
         p_rast.alloc(l_fragment_shader_header.size_of(), 8);
 
     rast::shader_fragment_bytes::view{l_fragment_shader_memory->data}.fill(
-        l_fragment_shader_header, p_fragment_uniforms, p_fragment);
+        l_fragment_shader_header, p_fragment_uniforms, p_fragment,
+        p_fragment_batch);
 
     program_rasterizer_handles l_program_rast_handles;
     l_program_rast_handles.m_vertex =
@@ -348,12 +398,16 @@ struct ren_impl {
       m_heap.m_camera_table.at(p_render_pass.m_camera.m_idx, &l_camera,
                                &l_frame_buffer);
 
+      // Every camera renders to its own view, so that the rasterizer can
+      // render the cameras concurrently.
+      bgfx::ViewId l_view = p_render_pass.m_camera.m_idx;
+
       // TODO -> having conditionals depneding if the frame buffer have depth ?
-      p_rast.setViewClear(0, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH);
-      p_rast.setViewRect(0, 0, 0, l_camera->m_width, l_camera->m_height);
-      p_rast.setViewTransform(0, l_camera->m_view.m_data,
+      p_rast.setViewClear(l_view, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH);
+      p_rast.setViewRect(l_view, 0, 0, l_camera->m_width, l_camera->m_height);
+      p_rast.setViewTransform(l_view, l_camera->m_view.m_data,
                               l_camera->m_projection.m_data);
-      p_rast.setViewFrameBuffer(0, *l_frame_buffer);
+      p_rast.setViewFrameBuffer(l_view, *l_frame_buffer);
 
       material *l_material;
       m_heap.m_materials.at(p_render_pass.m_material.m_idx, &l_material);
@@ -380,7 +434,7 @@ struct ren_impl {
       p_rast.setVertexBuffer(0, *l_vertex_buffer);
       p_rast.setState(l_state);
 
-      p_rast.submit(0, l_program_rast_handles->m_program);
+      p_rast.submit(l_view, l_program_rast_handles->m_program);
     });
   };
 
@@ -392,11 +446,21 @@ struct ren_impl {
     m_heap.m_camera_table.at(p_camera.m_idx, &l_camera, &l_frame_buffer);
     return rast::image_view(
         l_camera->m_width, l_camera->m_height,
-        textureformat_to_pixel_size(s_camera_rgb_format),
+        textureformat_to_pixel_size(l_camera->m_rgb_format),
         p_rast.fetchTextureSync(p_rast.getTexture(*l_frame_buffer)));
   };
 
 private:
+  template <typename Rasterizer>
+  bgfx::FrameBufferHandle
+  __camera_create_frame_buffer(const camera &p_camera,
+                               rast_api<Rasterizer> p_rast) {
+    return p_rast.createFrameBuffer(
+        p_camera.m_render_target, p_camera.m_rendertexture_width,
+        p_camera.m_rendertexture_height, p_camera.m_rgb_format,
+        s_camera_depth_format);
+  };
+
   template <typename CallbackFunc>
   void for_each_renderpass(const CallbackFunc &p_cb) {
     for (auto i = 0; i < m_heap.m_render_passes.count(); ++i) {
@@ -32,12 +32,106 @@
                      const ui8 *p_vertex, ui8 **p_uniforms,                    \
                      m::vec<fix32, 4> &out_screen_position, ui8 **out_vertex)
 
+// Optional batched counterpart of PROGRAM_VERTEX, see
+// rast::shader_vertex_batch_function.
+#define PROGRAM_VERTEX_BATCH                                                   \
+  static void vertex_batch(const rast::shader_vertex_runtime_ctx &p_ctx,       \
+                           const ui8 *p_vertices, uimax p_count,               \
+                           ui8 **p_uniforms, fix32 **out_screen_positions,     \
+                           ui8 **out_vertex)
+
 #define PROGRAM_FRAGMENT                                                       \
   static void fragment(ui8 **p_vertex_output_interpolated, ui8 **p_uniforms,   \
                        rgbf_t &out_color)
 
+// Optional batched counterpart of PROGRAM_FRAGMENT, see
+// rast::shader_fragment_batch_function.
+#define PROGRAM_FRAGMENT_BATCH                                                 \
+  static void fragment_batch(ui8 **p_vertex_output_interpolated,               \
+                             uimax p_count, ui8 **p_uniforms,                  \
+                             rgb_t *out_colors)
+
 namespace ren {
 
+// Batch entry points of a program definition that has no PROGRAM_VERTEX_BATCH
+// or PROGRAM_FRAGMENT_BATCH. The program functions are called from a loop
+// instantiated for the program type, so the compiler inlines them in the loop
+// instead of the rasterizer calling them by pointer once per vertex or pixel.
+template <typename ProgramDefinitionType> struct program_inline_batch {
+  inline static constexpr uimax s_vertex_output_count =
+      decltype(ProgramDefinitionType::s_meta.m_vertex_output)::count();
+
+  PROGRAM_VERTEX_BATCH {
+    ui16 l_element_sizes[s_vertex_output_count + 1];
+    for (auto j = 0; j < s_vertex_output_count; ++j) {
+      l_element_sizes[j] = ProgramDefinitionType::s_meta.m_vertex_output.at(j)
+                               .m_single_element_size;
+    }
+
+    ui8 *l_vertex_output[s_vertex_output_count + 1];
+    for (auto i = 0; i < p_count; ++i) {
+      for (auto j = 0; j < s_vertex_output_count; ++j) {
+        l_vertex_output[j] = out_vertex[j] + (i * l_element_sizes[j]);
+      }
+      m::vec<fix32, 4> l_screen_position;
+      ProgramDefinitionType::vertex(
+          p_ctx, p_vertices + (i * p_ctx.m_vertex_layout.m_stride), p_uniforms,
+          l_screen_position, l_vertex_output);
+      for (auto l_component_it = 0; l_component_it < 4; ++l_component_it) {
+        out_screen_positions[l_component_it][i] =
+            l_screen_position.at(l_component_it);
+      }
+    }
+  };
+
+  PROGRAM_FRAGMENT_BATCH {
+    ui16 l_element_sizes[s_vertex_output_count + 1];
+    for (auto j = 0; j < s_vertex_output_count; ++j) {
+      l_element_sizes[j] = ProgramDefinitionType::s_meta.m_vertex_output.at(j)
+                               .m_single_element_size;
+    }
+
+    ui8 *l_vertex_output[s_vertex_output_count + 1];
+    for (auto i = 0; i < p_count; ++i) {
+      for (auto j = 0; j < s_vertex_output_count; ++j) {
+        l_vertex_output[j] =
+            p_vertex_output_interpolated[j] + (i * l_element_sizes[j]);
+      }
+      rgbf_t l_color;
+      ProgramDefinitionType::fragment(l_vertex_output, p_uniforms, l_color);
+      out_colors[i] = (l_color * 255).cast<ui8>();
+    }
+  };
+};
+
+template <typename ProgramDefinitionType, typename = void>
+struct program_vertex_batch {
+  inline static constexpr rast::shader_vertex_batch_function value =
+      program_inline_batch<ProgramDefinitionType>::vertex_batch;
+};
+
+template <typename ProgramDefinitionType>
+struct program_vertex_batch<
+    ProgramDefinitionType,
+    traits::void_t<decltype(&ProgramDefinitionType::vertex_batch)>> {
+  inline static constexpr rast::shader_vertex_batch_function value =
+      ProgramDefinitionType::vertex_batch;
+};
+
+template <typename ProgramDefinitionType, typename = void>
+struct program_fragment_batch {
+  inline static constexpr rast::shader_fragment_batch_function value =
+      program_inline_batch<ProgramDefinitionType>::fragment_batch;
+};
+
+template <typename ProgramDefinitionType>
+struct program_fragment_batch<
+    ProgramDefinitionType,
+    traits::void_t<decltype(&ProgramDefinitionType::fragment_batch)>> {
+  inline static constexpr rast::shader_fragment_batch_function value =
+      ProgramDefinitionType::fragment_batch;
+};
+
 template <ui8 UniformCount, ui8 VertexUniformCount, ui8 VertexOutCount,
           ui8 FragmentUniformCount>
 struct program_definition_meta {
@@ -24,9 +24,19 @@ template <typename Private> struct ren_api {
   template <typename Rasterizer>
   FORCE_INLINE void camera_set_render_width_height(
       camera_handle p_camera, ui32 p_rendertexture_width,
-      ui32 p_rendertexture_height, rast_api<Rasterizer> p_rast) {
+      ui32 p_rendertexture_height, bgfx::TextureFormat::Enum p_rgb_format,
+      rast_api<Rasterizer> p_rast) {
     thiz.camera_set_render_width_height(p_camera, p_rendertexture_width,
-                                        p_rendertexture_height, p_rast);
+                                        p_rendertexture_height, p_rgb_format,
+                                        p_rast);
+  };
+
+  template <typename Rasterizer>
+  FORCE_INLINE void camera_set_render_target(
+      camera_handle p_camera, void *p_target, ui32 p_width, ui32 p_height,
+      bgfx::TextureFormat::Enum p_rgb_format, rast_api<Rasterizer> p_rast) {
+    thiz.camera_set_render_target(p_camera, p_target, p_width, p_height,
+                                  p_rgb_format, p_rast);
   };
 
   FORCE_INLINE void
@@ -96,11 +106,15 @@ template <typename Private> struct ren_api {
       const container::range<rast::shader_vertex_output_parameter>
           &p_vertex_output,
       rast::shader_vertex_function p_vertex,
+      rast::shader_vertex_batch_function p_vertex_batch,
       const container::range<rast::shader_uniform> &p_fragment_uniforms,
-      rast::shader_fragment_function p_fragment, rast_api<Rasterizer> p_rast) {
+      rast::shader_fragment_function p_fragment,
+      rast::shader_fragment_batch_function p_fragment_batch,
+      rast_api<Rasterizer> p_rast) {
     return thiz.program_create(p_program_meta, p_vertex_uniforms,
-                               p_vertex_output, p_vertex, p_fragment_uniforms,
-                               p_fragment, p_rast);
+                               p_vertex_output, p_vertex, p_vertex_batch,
+                               p_fragment_uniforms, p_fragment,
+                               p_fragment_batch, p_rast);
   };
 
   template <typename Rasterizer>
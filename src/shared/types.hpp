@@ -11,4 +11,12 @@ using rgba_t = m::vec<ui8, 4>;
 using rgbf_t = m::vec<fix32, 3>;
 using rgbaf_t = m::vec<fix32, 4>;
 using normal_t = m::vec<fix32, 3>;
-using vindex_t = ui16;
\ No newline at end of file
+using vindex_t = ui16;
+
+// Local space bounds of a mesh. The sphere is centered on the box.
+struct bounding_volume {
+  position_t m_min;
+  position_t m_max;
+  position_t m_center;
+  fix32 m_radius;
+};
\ No newline at end of file
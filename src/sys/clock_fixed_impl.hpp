@@ -1,11 +1,33 @@
 #pragma once
 
+#include <atomic>
 #include <sys/clock.hpp>
 
-inline static clock_time s_next_clock_time = {.m_seconds = 0, .m_micros = 0};
+// Time returned by the fixed clock, set by the tests. A single instance is
+// shared by every translation unit. Window present threads read it while the
+// tests write it, so it is stored as an atomic count of microseconds.
+struct clock_fixed_time {
+  std::atomic<clock_time::clock_time_t> m_micros{0};
+
+  clock_fixed_time &operator=(const clock_time &p_time) {
+    m_micros.store((p_time.m_seconds * clock_time::MAX_MICRO) +
+                   p_time.m_micros);
+    return *this;
+  };
+
+  clock_time load() const {
+    clock_time::clock_time_t l_micros = m_micros.load();
+    return clock_time::make_s_mics(l_micros / clock_time::MAX_MICRO,
+                                   l_micros % clock_time::MAX_MICRO);
+  };
+};
+
+inline clock_fixed_time s_next_clock_time;
 
 namespace clock_sys {
 
-inline extern clock_time get_current_time_micro() { return s_next_clock_time; };
+inline extern clock_time get_current_time_micro() {
+  return s_next_clock_time.load();
+};
 
 }; // namespace clock_sys
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <sys/sys.hpp>
+#include <sys/thread_impl.hpp>
 
 #include <cstdlib>
 #include <cstring>
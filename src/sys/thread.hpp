@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cor/types.hpp>
+
+namespace thread_sys {
+
+struct pool;
+
+// p_worker_index is in [0, worker_count) and is stable for the whole task, it
+// can be used to select per worker scratch memory.
+using task_function = void (*)(void *p_user, uimax p_task_index,
+                               uimax p_worker_index);
+
+extern uimax hardware_concurrency();
+
+// The calling thread is always worker 0, so a pool of one worker never spawns
+// any thread.
+extern pool *pool_create(uimax p_worker_count);
+extern void pool_destroy(pool *p_pool);
+extern uimax pool_worker_count(pool *p_pool);
+
+// Blocks until all the p_task_count tasks are executed.
+extern void pool_dispatch(pool *p_pool, uimax p_task_count,
+                          task_function p_function, void *p_user);
+
+struct thread;
+
+// Runs p_function(p_user, 0, 0) on a thread of its own. Null when the platform
+// has no threads, the caller then does the work itself.
+extern thread *thread_create(task_function p_function, void *p_user);
+// Blocks until the thread function returns and releases p_thread.
+extern void thread_join(thread *p_thread);
+
+// Auto reset event, a wait returns once for all the notifies made since the
+// previous wait.
+struct signal;
+
+extern signal *signal_create();
+extern void signal_destroy(signal *p_signal);
+extern void signal_notify(signal *p_signal);
+extern void signal_wait(signal *p_signal);
+
+}; // namespace thread_sys
+
+struct thread_pool {
+  thread_sys::pool *m_pool;
+
+  void allocate(uimax p_worker_count) {
+    if (p_worker_count == 0) {
+      p_worker_count = thread_sys::hardware_concurrency();
+    }
+    m_pool = thread_sys::pool_create(p_worker_count);
+  };
+
+  void free() { thread_sys::pool_destroy(m_pool); };
+
+  uimax worker_count() { return thread_sys::pool_worker_count(m_pool); };
+
+  template <typename CallbackFunc>
+  void dispatch(uimax p_task_count, const CallbackFunc &p_cb) {
+    thread_sys::pool_dispatch(
+        m_pool, p_task_count,
+        [](void *p_user, uimax p_task_index, uimax p_worker_index) {
+          (*(const CallbackFunc *)p_user)(p_task_index, p_worker_index);
+        },
+        (void *)&p_cb);
+  };
+};
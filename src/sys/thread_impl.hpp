@@ -0,0 +1,213 @@
+#pragma once
+
+#include <cor/assertions.hpp>
+#include <sys/thread.hpp>
+
+#if PLATFORM_WEBASSEMBLY_PREPROCESS
+
+namespace thread_sys {
+
+// No pthread support in the wasm build, tasks are executed by the caller.
+struct pool {};
+
+inline extern uimax hardware_concurrency() { return 1; };
+inline extern pool *pool_create(uimax p_worker_count) { return 0; };
+inline extern void pool_destroy(pool *p_pool){};
+inline extern uimax pool_worker_count(pool *p_pool) { return 1; };
+inline extern void pool_dispatch(pool *p_pool, uimax p_task_count,
+                                 task_function p_function, void *p_user) {
+  for (uimax i = 0; i < p_task_count; ++i) {
+    p_function(p_user, i, 0);
+  }
+};
+
+struct thread {};
+struct signal {};
+
+inline extern thread *thread_create(task_function p_function, void *p_user) {
+  return 0;
+};
+inline extern void thread_join(thread *p_thread){};
+inline extern signal *signal_create() { return 0; };
+inline extern void signal_destroy(signal *p_signal){};
+inline extern void signal_notify(signal *p_signal){};
+inline extern void signal_wait(signal *p_signal){};
+
+}; // namespace thread_sys
+
+#else
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace thread_sys {
+
+struct pool {
+  uimax m_worker_count;
+  std::thread *m_threads;
+
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_done;
+
+  ui64 m_generation;
+  ui8 m_exit;
+  uimax m_running_workers;
+
+  task_function m_function;
+  void *m_user;
+  uimax m_task_count;
+  std::atomic<uimax> m_next_task;
+
+  void execute_tasks(uimax p_worker_index) {
+    uimax l_task_index = m_next_task.fetch_add(1);
+    while (l_task_index < m_task_count) {
+      m_function(m_user, l_task_index, p_worker_index);
+      l_task_index = m_next_task.fetch_add(1);
+    }
+  };
+
+  void worker_loop(uimax p_worker_index) {
+    ui64 l_generation = 0;
+    while (1) {
+      {
+        std::unique_lock<std::mutex> l_lock(m_mutex);
+        m_wake.wait(l_lock,
+                    [&]() { return m_exit || m_generation != l_generation; });
+        if (m_exit) {
+          return;
+        }
+        l_generation = m_generation;
+      }
+
+      execute_tasks(p_worker_index);
+
+      {
+        std::unique_lock<std::mutex> l_lock(m_mutex);
+        m_running_workers -= 1;
+        if (m_running_workers == 0) {
+          m_done.notify_one();
+        }
+      }
+    }
+  };
+};
+
+inline extern uimax hardware_concurrency() {
+  uimax l_count = std::thread::hardware_concurrency();
+  if (l_count == 0) {
+    l_count = 1;
+  }
+  return l_count;
+};
+
+inline extern pool *pool_create(uimax p_worker_count) {
+  assert_debug(p_worker_count > 0);
+  pool *l_pool = new pool();
+  l_pool->m_worker_count = p_worker_count;
+  l_pool->m_generation = 0;
+  l_pool->m_exit = 0;
+  l_pool->m_running_workers = 0;
+  l_pool->m_task_count = 0;
+  l_pool->m_next_task = 0;
+  l_pool->m_threads = new std::thread[p_worker_count - 1];
+  for (uimax i = 1; i < p_worker_count; ++i) {
+    l_pool->m_threads[i - 1] =
+        std::thread([l_pool, i]() { l_pool->worker_loop(i); });
+  }
+  return l_pool;
+};
+
+inline extern void pool_destroy(pool *p_pool) {
+  {
+    std::unique_lock<std::mutex> l_lock(p_pool->m_mutex);
+    p_pool->m_exit = 1;
+  }
+  p_pool->m_wake.notify_all();
+  for (uimax i = 1; i < p_pool->m_worker_count; ++i) {
+    p_pool->m_threads[i - 1].join();
+  }
+  delete[] p_pool->m_threads;
+  delete p_pool;
+};
+
+inline extern uimax pool_worker_count(pool *p_pool) {
+  return p_pool->m_worker_count;
+};
+
+inline extern void pool_dispatch(pool *p_pool, uimax p_task_count,
+                                 task_function p_function, void *p_user) {
+  if (p_pool->m_worker_count == 1 || p_task_count <= 1) {
+    for (uimax i = 0; i < p_task_count; ++i) {
+      p_function(p_user, i, 0);
+    }
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> l_lock(p_pool->m_mutex);
+    p_pool->m_function = p_function;
+    p_pool->m_user = p_user;
+    p_pool->m_task_count = p_task_count;
+    p_pool->m_next_task = 0;
+    p_pool->m_running_workers = p_pool->m_worker_count - 1;
+    p_pool->m_generation += 1;
+  }
+  p_pool->m_wake.notify_all();
+
+  p_pool->execute_tasks(0);
+
+  std::unique_lock<std::mutex> l_lock(p_pool->m_mutex);
+  p_pool->m_done.wait(l_lock,
+                      [&]() { return p_pool->m_running_workers == 0; });
+};
+
+struct thread {
+  std::thread m_thread;
+};
+
+inline extern thread *thread_create(task_function p_function, void *p_user) {
+  thread *l_thread = new thread();
+  l_thread->m_thread =
+      std::thread([p_function, p_user]() { p_function(p_user, 0, 0); });
+  return l_thread;
+};
+
+inline extern void thread_join(thread *p_thread) {
+  p_thread->m_thread.join();
+  delete p_thread;
+};
+
+struct signal {
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  ui8 m_notified;
+};
+
+inline extern signal *signal_create() {
+  signal *l_signal = new signal();
+  l_signal->m_notified = 0;
+  return l_signal;
+};
+
+inline extern void signal_destroy(signal *p_signal) { delete p_signal; };
+
+inline extern void signal_notify(signal *p_signal) {
+  {
+    std::unique_lock<std::mutex> l_lock(p_signal->m_mutex);
+    p_signal->m_notified = 1;
+  }
+  p_signal->m_condition.notify_one();
+};
+
+inline extern void signal_wait(signal *p_signal) {
+  std::unique_lock<std::mutex> l_lock(p_signal->m_mutex);
+  p_signal->m_condition.wait(l_lock, [&]() { return p_signal->m_notified; });
+  p_signal->m_notified = 0;
+};
+
+}; // namespace thread_sys
+
+#endif
@@ -8,8 +8,10 @@ namespace win {
 void *create_window(ui32 p_width, ui32 p_height);
 void show_window(void *p_window);
 void close_window(void *p_window);
-void *allocate_image(void *p_window, void *p_buffer, ui32 p_width,
-                     ui32 p_height);
+// Allocates the pixels of a 32 bits image drawable in p_window. The pixel
+// memory is owned by the image and released by free_image.
+void *allocate_image(void *p_window, ui32 p_width, ui32 p_height,
+                     ui8 **out_buffer);
 void free_image(void *p_image);
 void draw(void *p_window, void *p_image, ui32 p_width, ui32 p_height);
 
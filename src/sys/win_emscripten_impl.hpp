@@ -85,7 +85,7 @@ struct emscripten_window {
 };
 
 struct emscripten_image {
-  ui8 *m_data;
+  container::span<ui8> m_data;
   ui16 m_width;
   ui16 m_height;
 };
@@ -125,11 +125,12 @@ void close_window(void *p_window) {
   delete l_window;
 };
 
-void *allocate_image(void *p_window, void *p_buffer, ui32 p_width,
-                     ui32 p_height) {
+void *allocate_image(void *p_window, ui32 p_width, ui32 p_height,
+                     ui8 **out_buffer) {
 
   emscripten_image *l_image = new emscripten_image();
-  l_image->m_data = (ui8 *)p_buffer;
+  l_image->m_data.allocate(p_width * p_height * (sizeof(ui8) * 4));
+  *out_buffer = l_image->m_data.m_data;
   l_image->m_width = p_width;
   l_image->m_height = p_height;
   return l_image;
@@ -137,6 +138,7 @@ void *allocate_image(void *p_window, void *p_buffer, ui32 p_width,
 
 void free_image(void *p_image) {
   emscripten_image *l_image = (emscripten_image *)p_image;
+  l_image->m_data.free();
   delete l_image;
 };
 
@@ -147,7 +149,7 @@ void draw(void *p_window, void *p_image, ui32 p_width, ui32 p_height) {
   s_library.call<void>(
       "blitToCanvas", l_window->m_ctx, p_width, p_height,
       emscripten::memory_view<ui8>(p_width * p_height * sizeof(ui8) * 4,
-                                   l_image->m_data));
+                                   l_image->m_data.m_data));
 };
 
 void fetch_events(container::range<events> &in_out_events) {
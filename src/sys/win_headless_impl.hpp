@@ -6,33 +6,37 @@ namespace win {
 inline static container::arr<win::event, 128> s_events;
 inline static ui8 s_events_count = 0;
 
+// Window and image pixels are 32 bits, in the eng::s_window_image_format of
+// headless builds.
 struct window_headless {
   container::span<ui8> m_buffer;
   ui16 m_width;
   ui16 m_height;
 
   rast::image_view image_view() {
-    return rast::image_view(m_width, m_height, sizeof(ui8) * 3,
+    return rast::image_view(m_width, m_height, sizeof(ui8) * 4,
                             m_buffer.range());
   };
 };
 
 struct window_headless_image {
-  void *m_buffer;
+  container::span<ui8> m_buffer;
   ui32 m_width;
   ui32 m_height;
 
   rast::image_view image_view() {
     return rast::image_view(
-        m_width, m_height, sizeof(ui8) * 3,
-        container::range<ui8>::make((ui8 *)m_buffer,
-                                    m_width * m_height * sizeof(ui8) * 3));
+        m_width, m_height, sizeof(ui8) * 4,
+        container::range<ui8>::make(m_buffer.m_data,
+                                    m_width * m_height * sizeof(ui8) * 4));
   };
 };
 
 void *create_window(ui32 p_width, ui32 p_height) {
   window_headless *l_window_headless = new window_headless();
-  l_window_headless->m_buffer.allocate(p_width * p_height * (sizeof(ui8) * 3));
+  l_window_headless->m_buffer.allocate(p_width * p_height * (sizeof(ui8) * 4));
+  l_window_headless->m_width = p_width;
+  l_window_headless->m_height = p_height;
   return l_window_headless;
 };
 
@@ -46,15 +50,19 @@ void close_window(void *p_window) {
   delete l_window;
 };
 
-void *allocate_image(void *p_window, void *p_buffer, ui32 p_width,
-                     ui32 p_height) {
+void *allocate_image(void *p_window, ui32 p_width, ui32 p_height,
+                     ui8 **out_buffer) {
   window_headless_image *l_image = new window_headless_image();
-  *l_image = {.m_buffer = p_buffer, .m_width = p_width, .m_height = p_height};
+  l_image->m_buffer.allocate(p_width * p_height * (sizeof(ui8) * 4));
+  l_image->m_width = p_width;
+  l_image->m_height = p_height;
+  *out_buffer = l_image->m_buffer.m_data;
   return l_image;
 };
 
 void free_image(void *p_image) {
   window_headless_image *l_image = (window_headless_image *)p_image;
+  l_image->m_buffer.free();
   delete l_image;
 };
 
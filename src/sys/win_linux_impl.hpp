@@ -2,9 +2,13 @@
 
 
 #include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
 #include <X11/keysym.h>
 #include <cor/assertions.hpp>
 #include <stdio.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
 #include <sys/sys.hpp>
 #include <sys/win.hpp>
 
@@ -17,6 +21,8 @@ int handler(Display *d, XErrorEvent *e) {
 
 void *win::create_window(ui32 p_width, ui32 p_height) {
   if (!s_display) {
+    // Windows are drawn by the present thread.
+    XInitThreads();
     s_display = XOpenDisplay(0);
     XSetErrorHandler(handler);
   }
@@ -48,22 +54,180 @@ void win::close_window(void *p_window) {
   s_display = 0;
 };
 
-void *win::allocate_image(void *p_window, void *p_buffer, ui32 p_width,
-                          ui32 p_height) {
-  Window l_window = (Window)p_window;
+// Images are put with MIT-SHM when the server supports it, the pixels then
+// live in a shared memory segment instead of going through the socket.
+struct x11_image {
+  XImage *m_image;
+  XShmSegmentInfo m_shm;
+  ui8 m_use_shm;
+  container::span<ui8> m_buffer;
+  // Set when the visual pixels are not 32 bits BGRA, m_buffer is then
+  // converted into the pixels of m_image before being put.
+  ui8 m_convert;
+  container::span<ui8> m_converted;
+};
+
+// The engine renders 32 bits BGRA pixels, they can be put as is only if the
+// image has the same layout.
+ui8 x11_image_is_bgra8(XImage *p_image, ui32 p_width) {
+  return p_image->bits_per_pixel == 32 &&
+         p_image->bytes_per_line == p_width * sizeof(ui32) &&
+         p_image->byte_order == LSBFirst && p_image->red_mask == 0xFF0000 &&
+         p_image->green_mask == 0xFF00 && p_image->blue_mask == 0xFF;
+};
+
+inline static ui8 s_shm_attach_failed = 0;
+
+int shm_attach_error_handler(Display *d, XErrorEvent *e) {
+  s_shm_attach_failed = 1;
+  return 0;
+};
+
+// The server can expose the extension but fail to attach the segment (remote
+// display), attach errors are trapped to fall back to XPutImage.
+ui8 shm_image_allocate(x11_image *p_image, ui32 p_width, ui32 p_height) {
+  int l_screen = DefaultScreen(s_display);
+  XImage *l_image = XShmCreateImage(
+      s_display, DefaultVisual(s_display, l_screen),
+      DefaultDepth(s_display, l_screen), ZPixmap, 0, &p_image->m_shm, p_width,
+      p_height);
+  if (!l_image) {
+    return 0;
+  }
+  if (!x11_image_is_bgra8(l_image, p_width)) {
+    XDestroyImage(l_image);
+    return 0;
+  }
+
+  p_image->m_shm.shmid = shmget(
+      IPC_PRIVATE, l_image->bytes_per_line * l_image->height, IPC_CREAT | 0600);
+  if (p_image->m_shm.shmid < 0) {
+    XDestroyImage(l_image);
+    return 0;
+  }
+  p_image->m_shm.shmaddr = (char *)shmat(p_image->m_shm.shmid, 0, 0);
+  // The segment is destroyed once both sides have detached it.
+  shmctl(p_image->m_shm.shmid, IPC_RMID, 0);
+  if (p_image->m_shm.shmaddr == (char *)-1) {
+    XDestroyImage(l_image);
+    return 0;
+  }
+  p_image->m_shm.readOnly = False;
+
+  s_shm_attach_failed = 0;
+  auto l_handler = XSetErrorHandler(shm_attach_error_handler);
+  XShmAttach(s_display, &p_image->m_shm);
+  XSync(s_display, False);
+  XSetErrorHandler(l_handler);
+  if (s_shm_attach_failed) {
+    shmdt(p_image->m_shm.shmaddr);
+    XDestroyImage(l_image);
+    return 0;
+  }
 
-  return XCreateImage(s_display,
-                      DefaultVisual(s_display, DefaultScreen(s_display)),
-                      DefaultDepth(s_display, DefaultScreen(s_display)),
-                      ZPixmap, 0, (char *)p_buffer, p_width, p_height, 8, 0);
+  l_image->data = p_image->m_shm.shmaddr;
+  p_image->m_image = l_image;
+  return 1;
 };
 
-void win::free_image(void *p_image){};
+void *win::allocate_image(void *p_window, ui32 p_width, ui32 p_height,
+                          ui8 **out_buffer) {
+  x11_image *l_image = new x11_image();
+  l_image->m_use_shm =
+      XShmQueryExtension(s_display) &&
+      shm_image_allocate(l_image, p_width, p_height);
+
+  if (l_image->m_use_shm) {
+    *out_buffer = (ui8 *)l_image->m_image->data;
+  } else {
+    l_image->m_buffer.allocate(p_width * p_height * sizeof(ui32));
+    l_image->m_image = XCreateImage(
+        s_display, DefaultVisual(s_display, DefaultScreen(s_display)),
+        DefaultDepth(s_display, DefaultScreen(s_display)), ZPixmap, 0, 0,
+        p_width, p_height, 32, 0);
+    l_image->m_convert = !x11_image_is_bgra8(l_image->m_image, p_width);
+    if (l_image->m_convert) {
+      l_image->m_converted.allocate(l_image->m_image->bytes_per_line *
+                                    p_height);
+      l_image->m_image->data = (char *)l_image->m_converted.m_data;
+    } else {
+      l_image->m_image->data = (char *)l_image->m_buffer.m_data;
+    }
+    *out_buffer = l_image->m_buffer.m_data;
+  }
+  return l_image;
+};
+
+void win::free_image(void *p_image) {
+  x11_image *l_image = (x11_image *)p_image;
+  if (l_image->m_use_shm) {
+    XShmDetach(s_display, &l_image->m_shm);
+    XSync(s_display, False);
+    shmdt(l_image->m_shm.shmaddr);
+  } else {
+    l_image->m_buffer.free();
+    if (l_image->m_convert) {
+      l_image->m_converted.free();
+    }
+  }
+  // Pixels are not owned by the XImage.
+  l_image->m_image->data = 0;
+  XDestroyImage(l_image->m_image);
+  delete l_image;
+};
+
+// Position and width of a visual channel mask.
+struct x11_channel {
+  ui8 m_shift;
+  ui8 m_bits;
+
+  x11_channel(unsigned long p_mask) : m_shift(0), m_bits(0) {
+    while (p_mask && !((p_mask >> m_shift) & 1)) {
+      m_shift += 1;
+    }
+    while ((p_mask >> (m_shift + m_bits)) & 1) {
+      m_bits += 1;
+    }
+  };
+
+  unsigned long to_pixel(ui8 p_value) const {
+    unsigned long l_value = p_value;
+    l_value = m_bits < 8 ? l_value >> (8 - m_bits) : l_value << (m_bits - 8);
+    return l_value << m_shift;
+  };
+};
+
+void x11_image_convert(x11_image *p_image, ui32 p_width, ui32 p_height) {
+  XImage *l_image = p_image->m_image;
+  x11_channel l_red = x11_channel(l_image->red_mask);
+  x11_channel l_green = x11_channel(l_image->green_mask);
+  x11_channel l_blue = x11_channel(l_image->blue_mask);
+  for (ui32 y = 0; y < p_height; ++y) {
+    for (ui32 x = 0; x < p_width; ++x) {
+      ui8 *l_bgra = p_image->m_buffer.m_data + (((y * p_width) + x) * 4);
+      XPutPixel(l_image, x, y,
+                l_blue.to_pixel(l_bgra[0]) | l_green.to_pixel(l_bgra[1]) |
+                    l_red.to_pixel(l_bgra[2]));
+    }
+  }
+};
 
 void win::draw(void *p_window, void *p_image, ui32 p_width, ui32 p_height) {
-  XPutImage(s_display, (Window)p_window,
-            DefaultGC(s_display, DefaultScreen(s_display)), (XImage *)p_image,
-            0, 0, 0, 0, p_width, p_height);
+  x11_image *l_image = (x11_image *)p_image;
+  if (l_image->m_convert) {
+    x11_image_convert(l_image, p_width, p_height);
+  }
+  GC l_gc = DefaultGC(s_display, DefaultScreen(s_display));
+  if (l_image->m_use_shm) {
+    XShmPutImage(s_display, (Window)p_window, l_gc, l_image->m_image, 0, 0, 0,
+                 0, p_width, p_height, False);
+    // The server reads the segment asynchronously, it must be done before the
+    // next frame is rendered in it.
+    XSync(s_display, False);
+  } else {
+    XPutImage(s_display, (Window)p_window, l_gc, l_image->m_image, 0, 0, 0, 0,
+              p_width, p_height);
+  }
 };
 
 container::vector<win::event> *
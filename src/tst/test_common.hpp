@@ -76,8 +76,7 @@ struct TestUtils {
       container::range<rgba_t> p_frame_buffer_rgba =
           p_engine.window_system()
               .window_get_image_buffer(p_engine.thiz.m_window)
-              .m_data.range()
-              .template cast_to<rgba_t>();
+              .m_data.template cast_to<rgba_t>();
 
       l_frame_buffer_rgb.allocate(p_frame_buffer_rgba.count());
       for (auto i = 0; i < p_frame_buffer_rgba.count(); ++i) {
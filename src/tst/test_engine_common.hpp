@@ -27,8 +27,8 @@ struct BaseEngineTest {
   container::vector<eng::object_handle> m_cameras;
   container::vector<eng::object_handle> m_mesh_renderers;
 
-  BaseEngineTest(ui16 p_width, ui16 p_height) {
-    __engine.allocate(p_width, p_height);
+  BaseEngineTest(ui16 p_width, ui16 p_height, ui16 p_worker_count = 0) {
+    __engine.allocate(p_width, p_height, p_worker_count);
     api_decltype(eng::engine_api, l_engine, __engine);
     l_scene = {&__engine};
     l_scene.allocate();
@@ -201,6 +201,12 @@ struct WhiteShader {
   };
 
   PROGRAM_FRAGMENT { out_color = {1, 1, 1}; };
+
+  PROGRAM_FRAGMENT_BATCH {
+    for (auto i = 0; i < p_count; ++i) {
+      out_colors[i] = {255, 255, 255};
+    }
+  };
 };
 
 struct ColorInterpolationShader {
@@ -222,8 +228,33 @@ struct ColorInterpolationShader {
     (*l_vertex_color) = l_color.cast<fix32>() / 255;
   };
 
+  PROGRAM_VERTEX_BATCH {
+    rast::shader_vertex l_shader = {p_ctx};
+    rgbf_t *l_vertex_colors = (rgbf_t *)out_vertex[0];
+    for (auto i = 0; i < p_count; ++i) {
+      const auto &l_vertex_pos = l_shader.get_vertex<position_t>(
+          bgfx::Attrib::Enum::Position, p_vertices, i);
+      const rgb_t &l_color =
+          l_shader.get_vertex<rgb_t>(bgfx::Attrib::Enum::Color0, p_vertices, i);
+      m::vec<fix32, 4> l_screen_position =
+          p_ctx.m_local_to_unit * m::vec<fix32, 4>::make(l_vertex_pos, 1);
+      for (auto l_component_it = 0; l_component_it < 4; ++l_component_it) {
+        out_screen_positions[l_component_it][i] =
+            l_screen_position.at(l_component_it);
+      }
+      l_vertex_colors[i] = l_color.cast<fix32>() / 255;
+    }
+  };
+
   PROGRAM_FRAGMENT {
     rgbf_t *l_vertex_color = (position_t *)p_vertex_output_interpolated[0];
     out_color = *l_vertex_color;
   };
+
+  PROGRAM_FRAGMENT_BATCH {
+    const rgbf_t *l_vertex_colors = (rgbf_t *)p_vertex_output_interpolated[0];
+    for (auto i = 0; i < p_count; ++i) {
+      out_colors[i] = (l_vertex_colors[i] * 255).cast<ui8>();
+    }
+  };
 };
\ No newline at end of file
@@ -63,6 +63,213 @@ f 1/1 2/2 3/3
   l_test.assert_frame_equals(l_tmp_path.range(), s_resource_config);
 }
 
+// The triangle of rast.single_triangle.vertex_color_interpolation and a copy
+// of it outside of the view frustum.
+TEST_CASE("rast.frustum_culling") {
+  constexpr ui16 l_width = 8, l_height = 8;
+  auto l_mesh_raw_str = container::arr_literal<ui8>(R""""(
+v 0.0 0.0 0.0
+v 0.0 1.0 0.0
+v 1.0 0.0 0.0
+vc 0 0 0
+vc 255 255 0
+vc 0 255 0
+f 1/1 2/2 3/3
+  )"""");
+
+  BaseEngineTest l_test = BaseEngineTest(l_width, l_height);
+  auto l_camera = l_test.create_orthographic_camera(2, 2);
+  l_test.l_scene.camera(l_camera).set_local_position({0, 0, -5});
+
+  ren::mesh_handle l_mesh = l_test.create_mesh_obj(l_mesh_raw_str.range());
+  ren::program_handle l_shader =
+      l_test.create_shader<ColorInterpolationShader>();
+  l_test.create_mesh_renderer(l_mesh, l_shader, l_test.material_default());
+  auto l_culled_mesh_renderer =
+      l_test.create_mesh_renderer(l_mesh, l_shader, l_test.material_default());
+  l_test.l_scene.mesh_renderer(l_culled_mesh_renderer)
+      .set_local_position({3, 0, 0});
+
+  l_test.update();
+
+  api_decltype(rast_api, l_rast, l_test.__engine.m_rasterizer);
+  REQUIRE(l_rast.getStats().m_culled_draws == 1);
+  REQUIRE(l_rast.getStats().m_draws.count() == 1);
+
+  auto l_tmp_path = container::arr_literal<ui8>(
+      "rast.single_triangle.vertex_color_interpolation.png");
+  l_test.assert_frame_equals(l_tmp_path.range(), s_resource_config);
+}
+
+// The triangle of rast.single_triangle.vertex_color_interpolation seen by two
+// cameras. Their render passes don't share a texture. They are rendered
+// concurrently as soon as there are two workers, each pass with its share of
+// the workers, and one after the other with a single worker.
+TEST_CASE("rast.render_pass.concurrent") {
+  constexpr ui16 l_width = 8, l_height = 8;
+  auto l_mesh_raw_str = container::arr_literal<ui8>(R""""(
+v 0.0 0.0 0.0
+v 0.0 1.0 0.0
+v 1.0 0.0 0.0
+vc 0 0 0
+vc 255 255 0
+vc 0 255 0
+f 1/1 2/2 3/3
+  )"""");
+
+  auto l_render = [&](ui16 p_worker_count, uimax p_concurrent_passes) {
+    BaseEngineTest l_test = BaseEngineTest(l_width, l_height, p_worker_count);
+    auto l_camera_0 = l_test.create_orthographic_camera(2, 2);
+    l_test.l_scene.camera(l_camera_0).set_local_position({0, 0, -5});
+    auto l_camera_1 = l_test.create_orthographic_camera(2, 2);
+    l_test.l_scene.camera(l_camera_1).set_local_position({0, 0, -5});
+
+    auto l_mesh_renderer = l_test.create_mesh_renderer(
+        l_test.create_mesh_obj(l_mesh_raw_str.range()),
+        l_test.create_shader<ColorInterpolationShader>(),
+        l_test.material_default());
+
+    l_test.update();
+
+    api_decltype(rast_api, l_rast, l_test.__engine.m_rasterizer);
+    REQUIRE(l_rast.getStats().m_draws.count() == 2);
+    REQUIRE(l_rast.getStats().m_concurrent_passes == p_concurrent_passes);
+    rast::image_view l_frame_0 = l_test.__engine.m_renderer.frame_view(
+        l_test.l_scene.m_cameras.at(l_camera_0.m_idx).m_camera, l_rast);
+    rast::image_view l_frame_1 = l_test.__engine.m_renderer.frame_view(
+        l_test.l_scene.m_cameras.at(l_camera_1.m_idx).m_camera, l_rast);
+    REQUIRE(l_frame_0.m_buffer.m_begin != l_frame_1.m_buffer.m_begin);
+    REQUIRE(l_frame_0.m_buffer.is_contained_by(l_frame_1.m_buffer));
+    // The presented camera renders in the window image buffer.
+    REQUIRE(l_frame_0.m_buffer.m_begin ==
+            l_test.__engine.m_window_system
+                .window_get_image_buffer(l_test.__engine.m_window)
+                .m_data.data());
+
+    auto l_tmp_path = container::arr_literal<ui8>(
+        "rast.single_triangle.vertex_color_interpolation.png");
+    l_test.assert_frame_equals(l_tmp_path.range(), s_resource_config);
+  };
+
+  l_render(2, 2);
+  l_render(4, 2);
+  l_render(1, 0);
+}
+
+// Tiles are rasterized independently, the frame doesn't depend on the number of
+// workers.
+TEST_CASE("rast.worker_count.identical_output") {
+  constexpr ui16 l_width = 300, l_height = 200;
+  auto l_mesh_raw_str = container::arr_literal<ui8>(R""""(
+v -1.0 -1.0 0.0
+v 0.9 -0.7 0.4
+v -0.3 1.0 0.2
+v 1.0 1.0 0.1
+v -0.8 0.3 0.3
+v 0.2 -1.0 -0.2
+vc 255 0 0
+vc 0 255 0
+vc 0 0 255
+vc 255 255 0
+vc 0 255 255
+vc 255 0 255
+f 1/1 2/2 3/3
+f 4/4 5/5 6/6
+  )"""");
+
+  auto l_render = [&](ui16 p_worker_count, container::span<ui8> &out_frame) {
+    BaseEngineTest l_test = BaseEngineTest(l_width, l_height, p_worker_count);
+    auto l_camera = l_test.create_orthographic_camera(2, 2);
+    l_test.l_scene.camera(l_camera).set_local_position({0, 0, -5});
+    auto l_mesh_renderer = l_test.create_mesh_renderer(
+        l_test.create_mesh_obj(l_mesh_raw_str.range()),
+        l_test.create_shader<ColorInterpolationShader>(),
+        l_test.material_default());
+    l_test.update();
+
+    container::range<ui8> l_frame =
+        l_test.__engine.m_window_system
+            .window_get_image_buffer(l_test.__engine.m_window)
+            .m_data;
+    out_frame.allocate(l_frame.count());
+    out_frame.range().copy_from(l_frame);
+  };
+
+  container::span<ui8> l_frame_single, l_frame_multiple;
+  l_render(1, l_frame_single);
+  l_render(4, l_frame_multiple);
+  REQUIRE(l_frame_single.range().is_contained_by(l_frame_multiple.range()));
+  l_frame_single.free();
+  l_frame_multiple.free();
+}
+
+// 32 bits pixels are stored in the byte order of their format.
+TEST_CASE("rast.color_format") {
+  container::arr<ui8, 8> l_buffer = {0};
+  rast::image_view l_target(2, 1, sizeof(ui32), l_buffer.range());
+  uimax l_pixels[1] = {1};
+  rgb_t l_colors[1] = {{10, 20, 30}};
+
+  rast::color_format::write(l_target, bgfx::TextureFormat::BGRA8, l_pixels,
+                            l_colors, 1);
+  REQUIRE(l_buffer.at(4) == 30);
+  REQUIRE(l_buffer.at(5) == 20);
+  REQUIRE(l_buffer.at(6) == 10);
+  REQUIRE(l_buffer.at(7) == 255);
+  rast::color_format::write(l_target, bgfx::TextureFormat::RGBA8, l_pixels,
+                            l_colors, 1);
+  REQUIRE(l_buffer.at(4) == 10);
+  REQUIRE(l_buffer.at(5) == 20);
+  REQUIRE(l_buffer.at(6) == 30);
+  REQUIRE(l_buffer.at(7) == 255);
+  REQUIRE(*(ui32 *)l_target.at(0) == 0);
+}
+
+TEST_CASE("rast.image_stretch") {
+  container::arr<ui8, 6> l_from_buffer = {0, 0, 0, 200, 100, 40};
+  container::arr<ui8, 16> l_to_buffer = {0};
+  rast::image_view l_from(2, 1, sizeof(rgb_t), l_from_buffer.range());
+  rast::image_view l_to(4, 1, sizeof(ui32), l_to_buffer.range());
+  rast::image_stretch l_stretch;
+  thread_pool l_workers;
+  l_stretch.allocate();
+  l_workers.allocate(1);
+
+  l_stretch.copy(l_from, l_to, rast::image_stretch::filter::Nearest,
+                 l_workers);
+  REQUIRE(l_to_buffer.at(4) == 0);
+  REQUIRE(l_to_buffer.at(7) == 255);
+  REQUIRE(l_to_buffer.at(8) == 200);
+  REQUIRE(l_to_buffer.at(14) == 40);
+
+  l_stretch.copy(l_from, l_to, rast::image_stretch::filter::Bilinear,
+                 l_workers);
+  REQUIRE(l_to_buffer.at(0) == 0);
+  REQUIRE(l_to_buffer.at(4) == 50);
+  REQUIRE(l_to_buffer.at(5) == 25);
+  REQUIRE(l_to_buffer.at(8) == 150);
+  REQUIRE(l_to_buffer.at(12) == 200);
+  REQUIRE(l_to_buffer.at(15) == 255);
+
+  // Rows wider than the 4 pixels widened at once.
+  container::arr<ui8, 9> l_row_buffer = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+  container::arr<ui32, 7> l_row_to_buffer = {0};
+  rast::image_view l_row_from(3, 1, sizeof(rgb_t), l_row_buffer.range());
+  rast::image_view l_row_to(7, 1, sizeof(ui32),
+                            l_row_to_buffer.range().cast_to<ui8>());
+  l_stretch.copy(l_row_from, l_row_to, rast::image_stretch::filter::Nearest,
+                 l_workers);
+  for (auto x = 0; x < 7; ++x) {
+    const ui8 *l_pixel = l_row_buffer.m_data + ((x * 3) / 7) * 3;
+    REQUIRE(l_row_to_buffer.at(x) ==
+            (ui32(l_pixel[0]) | (ui32(l_pixel[1]) << 8) |
+             (ui32(l_pixel[2]) << 16) | 0xFF000000));
+  }
+
+  l_workers.free();
+  l_stretch.free();
+}
+
 TEST_CASE("rast.cull.clockwise.counterclockwise") {
 
   constexpr ui16 l_width = 8, l_height = 8;
@@ -167,6 +374,94 @@ f 4/2 5/2 6/2
   l_test.assert_frame_equals(l_tmp_path.range(), s_resource_config);
 }
 
+// The red triangle is drawn first, blocks of the green triangle that are fully
+// behind it are rejected by the depth max cells without changing the output.
+TEST_CASE("rast.depth.comparison.depth_max") {
+  constexpr ui16 l_width = 400, l_height = 400;
+  auto l_mesh_raw_str = container::arr_literal<ui8>(R""""(
+v 0.0 0.0 0.0
+v 0.0 1.0 0.0
+v 1.0 0.0 0.0
+v -0.5 0.0 2.0
+v 0.0 1.0 2.0
+v 1.0 0.0 2.0
+vc 255 0 0
+vc 0 255 0
+f 1/1 2/1 3/1
+f 4/2 5/2 6/2
+  )"""");
+
+  BaseEngineTest l_test = BaseEngineTest(l_width, l_height);
+  auto l_camera = l_test.create_orthographic_camera(2, 2);
+  l_test.l_scene.camera(l_camera).set_local_position({0, 0, -5});
+
+  auto l_mesh_renderer = l_test.create_mesh_renderer(
+      l_test.create_mesh_obj(l_mesh_raw_str.range()),
+      l_test.create_shader<ColorInterpolationShader>(),
+      l_test.material_default());
+
+  l_test.update();
+
+  api_decltype(rast_api, l_rast, l_test.__engine.m_rasterizer);
+  const rast::frame_stats::depth_max &l_stats =
+      l_rast.getStats().m_depth_max;
+  REQUIRE(l_stats.m_polygon_tested > 0);
+  REQUIRE(l_stats.m_block_tested > 0);
+  REQUIRE(l_stats.m_block_rejected > 0);
+  REQUIRE(l_stats.m_block_rejected < l_stats.m_block_tested);
+
+  auto l_tmp_path = container::arr_literal<ui8>(
+      "rast.depth.comparison.large_framebuffer.png");
+  l_test.assert_frame_equals(l_tmp_path.range(), s_resource_config);
+}
+
+// rast.depth.comparison.large_framebuffer with one draw per triangle on a
+// deferred view, the green triangle is submitted first and is covered by the
+// red one. Pixels covered by both are shaded once.
+TEST_CASE("rast.depth.comparison.deferred") {
+  constexpr ui16 l_width = 400, l_height = 400;
+  auto l_red_mesh_raw_str = container::arr_literal<ui8>(R""""(
+v 0.0 0.0 0.0
+v 0.0 1.0 0.0
+v 1.0 0.0 0.0
+vc 255 0 0
+f 1/1 2/1 3/1
+  )"""");
+  auto l_green_mesh_raw_str = container::arr_literal<ui8>(R""""(
+v -0.5 0.0 0.1
+v 0.0 1.0 0.1
+v 1.0 0.0 0.1
+vc 0 255 0
+f 1/1 2/1 3/1
+  )"""");
+
+  BaseEngineTest l_test = BaseEngineTest(l_width, l_height);
+  auto l_camera = l_test.create_orthographic_camera(2, 2);
+  l_test.l_scene.camera(l_camera).set_local_position({0, 0, -5});
+
+  api_decltype(rast_api, l_rast, l_test.__engine.m_rasterizer);
+  l_rast.setViewDeferred(0, true);
+
+  auto l_shader = l_test.create_shader<ColorInterpolationShader>();
+  auto l_green_mesh_renderer = l_test.create_mesh_renderer(
+      l_test.create_mesh_obj(l_green_mesh_raw_str.range()), l_shader,
+      l_test.material_default());
+  auto l_red_mesh_renderer = l_test.create_mesh_renderer(
+      l_test.create_mesh_obj(l_red_mesh_raw_str.range()), l_shader,
+      l_test.material_default());
+
+  l_test.update();
+
+  const rast::frame_stats::deferred &l_stats = l_rast.getStats().m_deferred;
+  REQUIRE(l_stats.m_draws == 2);
+  REQUIRE(l_stats.m_shaded > 0);
+  REQUIRE(l_stats.m_shaded < l_width * l_height);
+
+  auto l_tmp_path = container::arr_literal<ui8>(
+      "rast.depth.comparison.large_framebuffer.png");
+  l_test.assert_frame_equals(l_tmp_path.range(), s_resource_config);
+}
+
 TEST_CASE("rast.depth.comparison.readonly") {
   constexpr ui16 l_width = 8, l_height = 8;
   auto l_mesh_raw_str = container::arr_literal<ui8>(R""""(
@@ -234,6 +529,315 @@ f 4/2 5/2 6/2
   l_test.assert_frame_equals(l_tmp_path.range(), s_resource_config);
 }
 
+// One polygon crosses the near and far planes, the other one the guard band.
+TEST_CASE("rast.clipping.near_far.guard_band") {
+
+  constexpr ui16 l_width = 32, l_height = 32;
+  auto l_mesh_raw_str = container::arr_literal<ui8>(R""""(
+v -1.0 -1.0 -60.0
+v 1.0 -1.0 60.0
+v 0.0 1.0 0.0
+v -5000.0 0.4 0.0
+v 5000.0 0.4 0.0
+v 0.0 0.8 0.0
+vc 255 0 0
+vc 0 255 0
+vc 0 0 255
+f 1/1 3/3 2/2
+f 4/1 6/3 5/2
+  )"""");
+
+  BaseEngineTest l_test = BaseEngineTest(l_width, l_height);
+  auto l_camera = l_test.create_orthographic_camera(2, 2);
+  l_test.l_scene.camera(l_camera).set_local_position({0, 0, -5});
+
+  auto l_mesh_renderer = l_test.create_mesh_renderer(
+      l_test.create_mesh_obj(l_mesh_raw_str.range()),
+      l_test.create_shader<ColorInterpolationShader>(),
+      l_test.material_default());
+
+  l_test.update();
+
+  auto l_tmp_path = container::arr_literal<ui8>(
+      "rast.clipping.near_far.guard_band.png");
+  l_test.assert_frame_equals(l_tmp_path.range(), s_resource_config);
+}
+
+// Ground plane seen by a perspective camera up to a far plane at 100000. Far
+// vertices have a w of 60000, their guard band distances don't fit in fix32.
+TEST_CASE("rast.clipping.guard_band.large_w") {
+  constexpr ui16 l_width = 32, l_height = 32;
+  auto l_mesh_raw_str = container::arr_literal<ui8>(R""""(
+v -2.0 -1.0 0.0
+v 2.0 -1.0 0.0
+v -60000.0 -1.0 60000.0
+v 60000.0 -1.0 60000.0
+vc 255 0 0
+vc 0 255 0
+vc 0 0 255
+f 1/1 3/3 2/2
+f 2/2 3/3 4/1
+  )"""");
+
+  BaseEngineTest l_test = BaseEngineTest(l_width, l_height);
+  auto l_camera = l_test.create_orthographic_camera(2, 2);
+  l_test.l_scene.camera(l_camera).set_local_position({0, 0, -5});
+
+  // w is the view depth, z goes from -w on the near plane to w on the far one.
+  fix32 l_near = 1, l_far = 100000;
+  m::mat<fix32, 4, 4> l_projection = {0};
+  l_projection.at(0, 0) = -1;
+  l_projection.at(1, 1) = -1;
+  l_projection.at(2, 2) = (l_far + l_near) / (l_far - l_near);
+  l_projection.at(3, 2) = (fix32(-2) * l_near) * (l_far / (l_far - l_near));
+  l_projection.at(2, 3) = 1;
+  l_test.l_scene.camera(l_camera).set_projection(l_projection);
+
+  auto l_mesh_renderer = l_test.create_mesh_renderer(
+      l_test.create_mesh_obj(l_mesh_raw_str.range()),
+      l_test.create_shader<ColorInterpolationShader>(),
+      l_test.material_default());
+
+  l_test.update();
+
+  auto l_tmp_path =
+      container::arr_literal<ui8>("rast.clipping.guard_band.large_w.png");
+  l_test.assert_frame_equals(l_tmp_path.range(), s_resource_config);
+}
+
+// The triangle of rast.single_triangle.vertex_color_interpolation and copies
+// of it above, below, left and right of the viewport, inside of the guard
+// band. The copies are not clipped and cover no pixel.
+TEST_CASE("rast.clipping.guard_band.outside_viewport") {
+  constexpr ui16 l_width = 8, l_height = 8;
+  auto l_mesh_raw_str = container::arr_literal<ui8>(R""""(
+v 0.0 0.0 0.0
+v 0.0 1.0 0.0
+v 1.0 0.0 0.0
+v -2.5 0.0 0.0
+v -2.5 1.0 0.0
+v -1.5 0.0 0.0
+v 2.0 0.0 0.0
+v 2.0 1.0 0.0
+v 3.0 0.0 0.0
+v 0.0 -2.5 0.0
+v 0.0 -1.5 0.0
+v 1.0 -2.5 0.0
+v 0.0 2.0 0.0
+v 0.0 3.0 0.0
+v 1.0 2.0 0.0
+vc 0 0 0
+vc 255 255 0
+vc 0 255 0
+f 1/1 2/2 3/3
+f 4/1 5/2 6/3
+f 7/1 8/2 9/3
+f 10/1 11/2 12/3
+f 13/1 14/2 15/3
+  )"""");
+
+  BaseEngineTest l_test = BaseEngineTest(l_width, l_height);
+  auto l_camera = l_test.create_orthographic_camera(2, 2);
+  l_test.l_scene.camera(l_camera).set_local_position({0, 0, -5});
+
+  auto l_mesh_renderer = l_test.create_mesh_renderer(
+      l_test.create_mesh_obj(l_mesh_raw_str.range()),
+      l_test.create_shader<ColorInterpolationShader>(),
+      l_test.material_default());
+
+  l_test.update();
+
+  auto l_tmp_path = container::arr_literal<ui8>(
+      "rast.single_triangle.vertex_color_interpolation.png");
+  l_test.assert_frame_equals(l_tmp_path.range(), s_resource_config);
+}
+
+// A grid of 40x40 quads drawn twice, 6400 triangles spread over several
+// polygon chunks. The plane goes from before the near plane to after the far
+// plane along x, so every chunk has clipped triangles and triangles entirely
+// outside of the frustum. Quads on a diagonal have the culled winding. The
+// second grid is white and has the same depth as the first one, it is
+// rejected as long as polygons are rasterized in submission order whatever
+// the worker count is.
+TEST_CASE("rast.chunks.cull.discard.clip") {
+  constexpr ui16 l_width = 64, l_height = 64;
+  constexpr ui16 l_cell_count = 40;
+  constexpr ui16 l_quad_count = 2 * l_cell_count * l_cell_count;
+
+  auto l_render = [&](ui16 p_worker_count) {
+    BaseEngineTest l_test = BaseEngineTest(l_width, l_height, p_worker_count);
+    auto l_camera = l_test.create_orthographic_camera(2, 2);
+    l_test.l_scene.camera(l_camera).set_local_position({0, 0, -5});
+
+    assets::mesh_composition l_composition = {};
+    l_composition.m_position = 1;
+    l_composition.m_color = 1;
+    assets::mesh l_mesh;
+    l_mesh.allocate(l_composition, l_quad_count * 4, l_quad_count * 6);
+    for (auto l_quad_it = 0; l_quad_it < l_quad_count; ++l_quad_it) {
+      ui16 l_cell = l_quad_it % (l_cell_count * l_cell_count);
+      ui16 l_x = l_cell % l_cell_count;
+      ui16 l_y = l_cell / l_cell_count;
+      ui8 l_white = l_quad_it != l_cell;
+      fix32 l_x0 = fix32(-1.2) + (fix32(0.06) * l_x);
+      fix32 l_y0 = fix32(-1.2) + (fix32(0.06) * l_y);
+      fix32 l_x1 = l_x0 + fix32(0.06);
+      fix32 l_y1 = l_y0 + fix32(0.06);
+      uimax l_vertex = l_quad_it * 4;
+      l_mesh.position().at(l_vertex + 0) = {l_x0, l_y0, (l_x0 * 60) + 20};
+      l_mesh.position().at(l_vertex + 1) = {l_x1, l_y0, (l_x1 * 60) + 20};
+      l_mesh.position().at(l_vertex + 2) = {l_x0, l_y1, (l_x0 * 60) + 20};
+      l_mesh.position().at(l_vertex + 3) = {l_x1, l_y1, (l_x1 * 60) + 20};
+      for (auto i = 0; i < 4; ++i) {
+        if (l_white) {
+          l_mesh.color().at(l_vertex + i) = {255, 255, 255};
+        } else {
+          l_mesh.color().at(l_vertex + i) = {
+              ui8(l_x * 6), ui8(l_y * 6), ui8(255 - (i * 60))};
+        }
+      }
+
+      vindex_t l_indices[6] = {0, 2, 1, 1, 2, 3};
+      if (((l_x + l_y) % 7) == 0) {
+        l_indices[1] = 1;
+        l_indices[2] = 2;
+        l_indices[4] = 3;
+        l_indices[5] = 2;
+      }
+      for (auto i = 0; i < 6; ++i) {
+        l_mesh.m_indices.at((l_quad_it * 6) + i) = l_vertex + l_indices[i];
+      }
+    }
+
+    api_decltype(eng::engine_api, l_engine, l_test.__engine);
+    ren::mesh_handle l_mesh_handle =
+        l_engine.renderer_api().mesh_create(l_mesh, l_engine.rasterizer_api());
+    l_mesh.free();
+    l_test.m_mesh_handles.push_back(l_mesh_handle);
+
+    auto l_mesh_renderer = l_test.create_mesh_renderer(
+        l_mesh_handle, l_test.create_shader<ColorInterpolationShader>(),
+        l_test.material_default());
+
+    l_test.update();
+
+    auto l_tmp_path =
+        container::arr_literal<ui8>("rast.chunks.cull.discard.clip.png");
+    l_test.assert_frame_equals(l_tmp_path.range(), s_resource_config);
+  };
+
+  l_render(1);
+  l_render(4);
+}
+
+// The triangle of rast.single_triangle.vertex_color_interpolation drawn twice
+// from a vertex buffer that has vertices no index refers to.
+TEST_CASE("rast.vertex_shading.on_demand") {
+  constexpr ui16 l_width = 8, l_height = 8;
+
+  BaseEngineTest l_test = BaseEngineTest(l_width, l_height);
+  auto l_camera = l_test.create_orthographic_camera(2, 2);
+  l_test.l_scene.camera(l_camera).set_local_position({0, 0, -5});
+
+  assets::mesh_composition l_composition = {};
+  l_composition.m_position = 1;
+  l_composition.m_color = 1;
+  assets::mesh l_mesh;
+  l_mesh.allocate(l_composition, 600, 6);
+  for (auto i = 0; i < 600; ++i) {
+    l_mesh.position().at(i) = {5, 5, 0};
+    l_mesh.color().at(i) = {255, 255, 255};
+  }
+  l_mesh.position().at(1) = {0, 0, 0};
+  l_mesh.position().at(300) = {0, 1, 0};
+  l_mesh.position().at(598) = {1, 0, 0};
+  l_mesh.color().at(1) = {0, 0, 0};
+  l_mesh.color().at(300) = {255, 255, 0};
+  l_mesh.color().at(598) = {0, 255, 0};
+  vindex_t l_indices[6] = {1, 300, 598, 1, 300, 598};
+  for (auto i = 0; i < 6; ++i) {
+    l_mesh.m_indices.at(i) = l_indices[i];
+  }
+
+  api_decltype(eng::engine_api, l_engine, l_test.__engine);
+  ren::mesh_handle l_mesh_handle =
+      l_engine.renderer_api().mesh_create(l_mesh, l_engine.rasterizer_api());
+  l_mesh.free();
+  l_test.m_mesh_handles.push_back(l_mesh_handle);
+
+  auto l_mesh_renderer = l_test.create_mesh_renderer(
+      l_mesh_handle, l_test.create_shader<ColorInterpolationShader>(),
+      l_test.material_default());
+
+  l_test.update();
+
+  api_decltype(rast_api, l_rast, l_test.__engine.m_rasterizer);
+  const auto &l_draws = l_rast.getStats().m_draws;
+  REQUIRE(l_draws.count() == 1);
+  REQUIRE(l_draws.at(0).m_on_demand);
+  REQUIRE(l_draws.at(0).m_vertex_count == 600);
+  REQUIRE(l_draws.at(0).m_index_count == 6);
+  REQUIRE(l_draws.at(0).m_reused == 3);
+  REQUIRE(l_draws.at(0).m_shaded == 3);
+
+  auto l_tmp_path = container::arr_literal<ui8>(
+      "rast.single_triangle.vertex_color_interpolation.png");
+  l_test.assert_frame_equals(l_tmp_path.range(), s_resource_config);
+}
+
+TEST_CASE("rast.vertex_shading.referenced_range") {
+  constexpr ui16 l_width = 8, l_height = 8;
+
+  BaseEngineTest l_test = BaseEngineTest(l_width, l_height);
+  auto l_camera = l_test.create_orthographic_camera(2, 2);
+  l_test.l_scene.camera(l_camera).set_local_position({0, 0, -5});
+
+  assets::mesh_composition l_composition = {};
+  l_composition.m_position = 1;
+  l_composition.m_color = 1;
+  assets::mesh l_mesh;
+  l_mesh.allocate(l_composition, 8, 3);
+  for (auto i = 0; i < 8; ++i) {
+    l_mesh.position().at(i) = {5, 5, 0};
+    l_mesh.color().at(i) = {255, 255, 255};
+  }
+  l_mesh.position().at(2) = {0, 0, 0};
+  l_mesh.position().at(3) = {0, 1, 0};
+  l_mesh.position().at(4) = {1, 0, 0};
+  l_mesh.color().at(2) = {0, 0, 0};
+  l_mesh.color().at(3) = {255, 255, 0};
+  l_mesh.color().at(4) = {0, 255, 0};
+  vindex_t l_indices[3] = {2, 3, 4};
+  for (auto i = 0; i < 3; ++i) {
+    l_mesh.m_indices.at(i) = l_indices[i];
+  }
+
+  api_decltype(eng::engine_api, l_engine, l_test.__engine);
+  ren::mesh_handle l_mesh_handle =
+      l_engine.renderer_api().mesh_create(l_mesh, l_engine.rasterizer_api());
+  l_mesh.free();
+  l_test.m_mesh_handles.push_back(l_mesh_handle);
+
+  auto l_mesh_renderer = l_test.create_mesh_renderer(
+      l_mesh_handle, l_test.create_shader<ColorInterpolationShader>(),
+      l_test.material_default());
+
+  l_test.update();
+
+  // Vertices outside of the referenced [2, 4] range are not shaded.
+  api_decltype(rast_api, l_rast, l_test.__engine.m_rasterizer);
+  const auto &l_draws = l_rast.getStats().m_draws;
+  REQUIRE(l_draws.count() == 1);
+  REQUIRE(!l_draws.at(0).m_on_demand);
+  REQUIRE(l_draws.at(0).m_vertex_count == 8);
+  REQUIRE(l_draws.at(0).m_reused == 0);
+  REQUIRE(l_draws.at(0).m_shaded == 3);
+
+  auto l_tmp_path = container::arr_literal<ui8>(
+      "rast.single_triangle.vertex_color_interpolation.png");
+  l_test.assert_frame_equals(l_tmp_path.range(), s_resource_config);
+}
+
 struct rast_uniform_vertex_shader {
   PROGRAM_UNIFORM(0, bgfx::UniformType::Vec4, "test_vertex_uniform_0");
   PROGRAM_UNIFORM(1, bgfx::UniformType::Vec4, "test_vertex_uniform_1");
@@ -513,4 +1117,5 @@ f 1 2 3
   l_test.assert_frame_equals(l_tmp_path.range(), s_resource_config);
 }
 
+#include <sys/clock_impl.hpp>
 #include <sys/sys_impl.hpp>
\ No newline at end of file
@@ -352,4 +352,5 @@ TEST_CASE("ren.cube.corner.down.3") {
   l_test.assert_frame_equals(l_tmp_path.range(), s_resource_config);
 }
 
+#include <sys/clock_impl.hpp>
 #include <sys/sys_impl.hpp>
\ No newline at end of file
@@ -52,5 +52,6 @@ TEST_CASE("window_system.input") {
   l_window_system.free();
 }
 
+#include <sys/clock_impl.hpp>
 #include <sys/sys_impl.hpp>
 #include <sys/win_impl.hpp>
\ No newline at end of file